@@ -57,6 +57,7 @@ public class MotionMatching : ModuleRules
                 "BlueprintGraph",
                 "AssetRegistry",
                 "AdvancedPreviewScene",
+                "TraceLog",
             }
 			);
 
@@ -1,33 +1,52 @@
 #include "AnimContainer.h"
-#include "AnimationRuntime.h"
+#include "MotionMatchingStats.h"
+#include "Misc/MemStack.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
 
-void FAnimContainer::Init(const TArray<UAnimSequence*>& InAnimationsArray, float InAnimationSampling)
+namespace
 {
-	AnimationsArray = InAnimationsArray;
-	AnimationSampling = InAnimationSampling;
-}
+	FVector QuatToScaledAxis(FQuat Quat)
+	{
+		Quat.EnforceShortestArcWith(FQuat::Identity);
 
-void FAnimContainer::ResetKey()
-{
-	CurrentKey.StartTime = 0.0f;
-	CurrentKey.Index = 0;
-}
+		FVector axis;
+		float angle;
+		Quat.ToAxisAndAngle(axis, angle);
 
-void FAnimContainer::IncrementKey()
-{
-	CurrentKey.StartTime += AnimationSampling;
+		return axis * angle;
+	}
+
+	FQuat ScaledAxisToQuat(const FVector& ScaledAxis)
+	{
+		const float angle = ScaledAxis.Size();
+
+		return (angle > SMALL_NUMBER) ? FQuat{ScaledAxis / angle, angle} : FQuat::Identity;
+	}
+
+	// Critically damped spring towards zero, solved exactly for DeltaTime so that the result does not depend on
+	// the frame rate:
+	void DecaySpring(FVector& Offset, FVector& Velocity, float Damping, float DeltaTime)
+	{
+		const FVector j1 = Velocity + Offset * Damping;
+		const float decay = FMath::Exp(-Damping * DeltaTime);
 
-	if (CurrentKey.StartTime > GetAnimation(CurrentKey).SequenceLength &&
-		CurrentKey.Index < AnimationsArray.Num() - 1)
+		Offset = (Offset + j1 * DeltaTime) * decay;
+		Velocity = (Velocity - j1 * Damping * DeltaTime) * decay;
+	}
+
+	void ApplyOffset(FTransform& Transform, const FBoneTransitionOffset& Offset, float Weight)
 	{
-		CurrentKey.Index += 1;
-		CurrentKey.StartTime = 0.0f;
+		Transform.SetRotation(ScaledAxisToQuat(Offset.Rotation * Weight) * Transform.GetRotation());
+		Transform.SetTranslation(Transform.GetTranslation() + Offset.Translation * Weight);
+		Transform.SetScale3D(Transform.GetScale3D() + Offset.Scale * Weight);
 	}
 }
 
-FAnimKey FAnimContainer::MaxKey() const
+void FAnimContainer::Init(const TArray<UAnimSequence*>& InAnimationsArray, float InAnimationSampling)
 {
-	return FAnimKey{AnimationsArray.Num() - 1, AnimationsArray.Last()->SequenceLength};
+	AnimationsArray = InAnimationsArray;
+	AnimationSampling = InAnimationSampling;
+	MirrorTable.Reset();
 }
 
 const UAnimSequence& FAnimContainer::GetAnimation(const FAnimKey& AnimKey) const
@@ -37,6 +56,9 @@ const UAnimSequence& FAnimContainer::GetAnimation(const FAnimKey& AnimKey) const
 
 FTransform FAnimContainer::ExtractRootMotion(const FAnimKey& AnimKey, float DeltaTime) const
 {
+	SCOPE_CYCLE_COUNTER(STAT_MotionMatchingRootMotion);
+	TRACE_CPUPROFILER_EVENT_SCOPE(MotionMatchingRootMotion);
+
 	const UAnimSequence& animSequence = GetAnimation(AnimKey);
 
 	if (AnimKey.StartTime > animSequence.SequenceLength)
@@ -44,14 +66,29 @@ FTransform FAnimContainer::ExtractRootMotion(const FAnimKey& AnimKey, float Delt
 		return FTransform::Identity;
 	}
 
-	return animSequence.ExtractRootMotion(AnimKey.StartTime, DeltaTime, true);
+	const FTransform& rootMotion = animSequence.ExtractRootMotion(AnimKey.StartTime, DeltaTime, true);
+
+	return AnimKey.bMirrored ? MirrorTable.MirrorTransform(rootMotion) : rootMotion;
 }
 
 void FAnimContainer::GetPose(FPoseContext& PoseContext, const FAnimKey& AnimKey) const
 {
+	GetPose(PoseContext.Pose, PoseContext.Curve, AnimKey);
+}
+
+void FAnimContainer::GetPose(FCompactPose& Pose, FBlendedCurve& Curve, const FAnimKey& AnimKey) const
+{
+	SCOPE_CYCLE_COUNTER(STAT_MotionMatchingPoseEvaluation);
+	TRACE_CPUPROFILER_EVENT_SCOPE(MotionMatchingPoseEvaluation);
+
 	const FAnimExtractContext& animExtractContext = FAnimExtractContext(AnimKey.StartTime, true);
 
-	GetAnimation(AnimKey).GetAnimationPose(PoseContext.Pose, PoseContext.Curve, animExtractContext);
+	GetAnimation(AnimKey).GetAnimationPose(Pose, Curve, animExtractContext);
+
+	if (AnimKey.bMirrored)
+	{
+		MirrorTable.MirrorPose(Pose);
+	}
 }
 
 FTransform FAnimContainer::ExtractBlendedRootMotion(const FAnimKey& PreviousAnimKey, const FAnimKey& NewAnimKey, float BlendWeight, float DeltaTime) const
@@ -63,15 +100,154 @@ FTransform FAnimContainer::ExtractBlendedRootMotion(const FAnimKey& PreviousAnim
 	return newRootMotion;
 }
 
-void FAnimContainer::GetBlendedPose(FPoseContext& PoseContext, const FAnimKey& PreviousAnimKey, const FAnimKey& NewAnimKey, float BlendWeight) const
+void FAnimContainer::StartTransition(const FPoseContext& PoseContext, const FAnimKey& PreviousAnimKey, const FAnimKey& NewAnimKey, float CurrentBlendWeight, bool bComputeVelocities)
+{
+	StartTransition(PoseContext.Pose.GetBoneContainer(), PreviousAnimKey, NewAnimKey, CurrentBlendWeight, bComputeVelocities);
+}
+
+void FAnimContainer::StartTransition(const FBoneContainer& BoneContainer, const FAnimKey& PreviousAnimKey, const FAnimKey& NewAnimKey, float CurrentBlendWeight, bool bComputeVelocities)
 {
-	FPoseContext previousPoseContext{PoseContext};
-	GetPose(previousPoseContext, PreviousAnimKey);
+	// Poses and curves allocate from the mem stack, so the samples only live as long as this transition. Two poses are
+	// enough because the outgoing clip's velocity is recorded before the incoming pose is sampled:
+	FMemMark mark{FMemStack::Get()};
+	FCompactPose previousPose;
+	FCompactPose newPose;
+	FBlendedCurve curve;
+	previousPose.SetBoneContainer(&BoneContainer);
+	newPose.SetBoneContainer(&BoneContainer);
+	curve.InitFrom(BoneContainer);
+
+	GetPose(previousPose, curve, PreviousAnimKey);
+
+	// Offsets of a transition that has not settled yet are still on screen and carried into the new ones, unless
+	// they were recorded for another set of required bones:
+	const bool bHasCurrentOffsets = (TransitionOffsets.Num() == previousPose.GetNumBones()) && (CurrentBlendWeight > 0.0f);
+
+	if (!bHasCurrentOffsets)
+	{
+		TransitionOffsets.Reset();
+		TransitionOffsets.AddDefaulted(previousPose.GetNumBones());
+	}
+
+	const bool bHasVelocities = bComputeVelocities && AnimationSampling > 0.0f;
 
-	FPoseContext newPoseContext{PoseContext};
-	GetPose(newPoseContext, NewAnimKey);
+	// The outgoing clip's velocity is taken from the sample before the switch:
+	if (bHasVelocities)
+	{
+		FCompactPose& previousPastPose = newPose;
+		GetPose(previousPastPose, curve, FAnimKey{PreviousAnimKey.Index, FMath::Max(PreviousAnimKey.StartTime - AnimationSampling, 0.0f), PreviousAnimKey.bMirrored});
+
+		for (const FCompactPoseBoneIndex boneIndex : previousPose.ForEachBoneIndex())
+		{
+			const FTransform& previousTransform = previousPose[boneIndex];
+			const FTransform& previousPastTransform = previousPastPose[boneIndex];
+
+			FBoneTransitionOffset& offset = TransitionOffsets[boneIndex.GetInt()];
+			offset.TranslationVelocity += (previousTransform.GetTranslation() - previousPastTransform.GetTranslation()) / AnimationSampling;
+			offset.RotationVelocity += QuatToScaledAxis(previousTransform.GetRotation() * previousPastTransform.GetRotation().Inverse()) / AnimationSampling;
+			offset.ScaleVelocity += (previousTransform.GetScale3D() - previousPastTransform.GetScale3D()) / AnimationSampling;
+		}
+	}
+	else
+	{
+		for (FBoneTransitionOffset& offset : TransitionOffsets)
+		{
+			offset.TranslationVelocity = FVector::ZeroVector;
+			offset.RotationVelocity = FVector::ZeroVector;
+			offset.ScaleVelocity = FVector::ZeroVector;
+		}
+	}
+
+	// The new offsets start from the pose on screen, the outgoing clip with what is left of the current offsets:
+	if (bHasCurrentOffsets)
+	{
+		for (const FCompactPoseBoneIndex boneIndex : previousPose.ForEachBoneIndex())
+		{
+			ApplyOffset(previousPose[boneIndex], TransitionOffsets[boneIndex.GetInt()], CurrentBlendWeight);
+		}
+	}
+
+	GetPose(newPose, curve, NewAnimKey);
+
+	for (const FCompactPoseBoneIndex boneIndex : newPose.ForEachBoneIndex())
+	{
+		const FTransform& previousTransform = previousPose[boneIndex];
+		const FTransform& newTransform = newPose[boneIndex];
+
+		FBoneTransitionOffset& offset = TransitionOffsets[boneIndex.GetInt()];
+		offset.Translation = previousTransform.GetTranslation() - newTransform.GetTranslation();
+		offset.Rotation = QuatToScaledAxis(previousTransform.GetRotation() * newTransform.GetRotation().Inverse());
+		offset.Scale = previousTransform.GetScale3D() - newTransform.GetScale3D();
+	}
+
+	if (!bHasVelocities)
+	{
+		return;
+	}
+
+	// The incoming one's from the sample after, into the pose that is not needed anymore:
+	FCompactPose& newFuturePose = previousPose;
+	GetPose(newFuturePose, curve, FAnimKey{NewAnimKey.Index, NewAnimKey.StartTime + AnimationSampling, NewAnimKey.bMirrored});
+
+	for (const FCompactPoseBoneIndex boneIndex : newPose.ForEachBoneIndex())
+	{
+		const FTransform& newTransform = newPose[boneIndex];
+		const FTransform& newFutureTransform = newFuturePose[boneIndex];
+
+		FBoneTransitionOffset& offset = TransitionOffsets[boneIndex.GetInt()];
+		offset.TranslationVelocity -= (newFutureTransform.GetTranslation() - newTransform.GetTranslation()) / AnimationSampling;
+		offset.RotationVelocity -= QuatToScaledAxis(newFutureTransform.GetRotation() * newTransform.GetRotation().Inverse()) / AnimationSampling;
+		offset.ScaleVelocity -= (newFutureTransform.GetScale3D() - newTransform.GetScale3D()) / AnimationSampling;
+	}
+}
+
+void FAnimContainer::DecayTransition(float DeltaTime, float HalfLife)
+{
+	if (TransitionOffsets.Num() == 0)
+	{
+		return;
+	}
+
+	// Half of the critical damping that halves the offset every HalfLife, ln(2) * 4 / HalfLife:
+	const float damping = 2.0f * 0.69314718f / FMath::Max(HalfLife, KINDA_SMALL_NUMBER);
+	float largestOffset = 0.0f;
+
+	for (FBoneTransitionOffset& offset : TransitionOffsets)
+	{
+		DecaySpring(offset.Translation, offset.TranslationVelocity, damping, DeltaTime);
+		DecaySpring(offset.Rotation, offset.RotationVelocity, damping, DeltaTime);
+		DecaySpring(offset.Scale, offset.ScaleVelocity, damping, DeltaTime);
+
+		largestOffset = FMath::Max3(largestOffset, offset.Translation.GetAbsMax(), offset.Rotation.GetAbsMax());
+		largestOffset = FMath::Max3(largestOffset, offset.Scale.GetAbsMax(), offset.TranslationVelocity.GetAbsMax());
+		largestOffset = FMath::Max3(largestOffset, offset.RotationVelocity.GetAbsMax(), offset.ScaleVelocity.GetAbsMax());
+	}
+
+	if (largestOffset < SettledOffset)
+	{
+		TransitionOffsets.Reset();
+	}
+}
+
+void FAnimContainer::GetBlendedPose(FPoseContext& PoseContext, const FAnimKey& NewAnimKey, float BlendWeight) const
+{
+	GetBlendedPose(PoseContext.Pose, PoseContext.Curve, NewAnimKey, BlendWeight);
+}
+
+void FAnimContainer::GetBlendedPose(FCompactPose& Pose, FBlendedCurve& Curve, const FAnimKey& NewAnimKey, float BlendWeight) const
+{
+	GetPose(Pose, Curve, NewAnimKey);
 
 	BlendWeight = FMath::Clamp<float>(BlendWeight, 0.f, 1.f);
 
-	FAnimationRuntime::BlendTwoPosesTogether(previousPoseContext.Pose, newPoseContext.Pose, previousPoseContext.Curve, newPoseContext.Curve, BlendWeight, PoseContext.Pose, PoseContext.Curve);
+	// Offsets recorded for another set of required bones (e.g. before a LOD change) are dropped:
+	if (BlendWeight <= 0.0f || TransitionOffsets.Num() != Pose.GetNumBones())
+	{
+		return;
+	}
+
+	for (const FCompactPoseBoneIndex boneIndex : Pose.ForEachBoneIndex())
+	{
+		ApplyOffset(Pose[boneIndex], TransitionOffsets[boneIndex.GetInt()], BlendWeight);
+	}
 }
@@ -1,10 +1,29 @@
 #include "AnimNode_MotionMatching.h"
+#include "MotionMatching.h"
+#include "MotionDatabaseAsset.h"
+#include "MotionMatchingSearchBudget.h"
 #include "Animation/AnimInstance.h"
 #include "Animation/AnimSequence.h"
+#include "Async/Async.h"
+#include "BonePose.h"
+#include "Components/SkeletalMeshComponent.h"
 #include "DrawDebugHelpers.h"
+#include "Engine/SkeletalMesh.h"
 #include "GameFramework/CharacterMovementComponent.h"
+#include "HAL/IConsoleManager.h"
 #include "Kismet/KismetSystemLibrary.h"
+#include "Misc/Paths.h"
 
+namespace
+{
+	// BlendWeightDecrement is given per frame at this rate.
+	constexpr float BlendReferenceFrameRate = 60.0f;
+
+	TAutoConsoleVariable<int32> CVarMotionMatchingRecord(
+		TEXT("MotionMatching.Record"),
+		0,
+		TEXT("1 records the search decisions of every motion matching node initialized from now on, like UseRecording."));
+}
 
 void FAnimNode_MotionMatching::OnInitializeAnimInstance(const FAnimInstanceProxy* InProxy, const UAnimInstance* InAnimInstance)
 {
@@ -17,10 +36,81 @@ void FAnimNode_MotionMatching::OnInitializeAnimInstance(const FAnimInstanceProxy
 	
 	SkeletalMeshComponent = InAnimInstance->GetSkelMeshComponent();
 	OwnerPawn = InAnimInstance->TryGetPawnOwner();
+	TrajectoryComponent = OwnerPawn ? OwnerPawn->FindComponentByClass<UMotionTrajectoryComponent>() : nullptr;
+	TrajectoryPoints.Reset();
 	World = InAnimInstance->GetWorld();	
 	BoneNames.Remove(NAME_None);
-	AnimationContainer.Init(AnimationsArray, AnimationSampling);
-	LoadBoneToRootTransforms();
+
+	if (MotionDatabase)
+	{
+		AnimationContainer.Init(MotionDatabase->AnimationsArray, MotionDatabase->AnimationSampling);
+		Database = MotionDatabase->GetDatabase();
+	}
+	else
+	{
+		AnimationContainer.Init(AnimationsArray, AnimationSampling);
+
+		// Every instance built from the same data shares one database:
+		FMotionDatabaseSettings databaseSettings;
+		databaseSettings.Animations = AnimationsArray;
+		databaseSettings.Skeleton = (SkeletalMeshComponent && SkeletalMeshComponent->SkeletalMesh) ? SkeletalMeshComponent->SkeletalMesh->Skeleton : nullptr;
+		databaseSettings.BoneNames = BoneNames;
+		databaseSettings.AnimationSampling = AnimationSampling;
+		databaseSettings.TrajectoryTimes = TrajectoryTimes;
+		databaseSettings.SearchMode = SearchMode;
+
+		for (const FMotionMatchingLODProfile& lodProfile : LODProfiles)
+		{
+			if (lodProfile.UseSearchMode && lodProfile.SearchMode != SearchMode)
+			{
+				databaseSettings.AdditionalSearchModes.AddUnique(lodProfile.SearchMode);
+			}
+		}
+
+		databaseSettings.Quantization = Quantization;
+		databaseSettings.MirrorAxis = UseMirroring ? MirrorAxis.GetValue() : EAxis::None;
+		databaseSettings.MirrorBonePairs = MirrorBonePairs;
+		databaseSettings.IndexWeights = GetFeatureWeights();
+		Database = FMotionDatabaseCache::Get().FindOrBuild(databaseSettings);
+	}
+
+	// Mirrored samples are played back through the table their features were built with:
+	if (Database.IsValid())
+	{
+		AnimationContainer.SetMirrorTable(Database->MirrorTable);
+	}
+
+	UpdateQueryWeights();
+	InitHistory();
+	Counters.Reset();
+	StartRecording(InAnimInstance);
+
+	// Each instance gets its own search phase, so that a crowd spreads its searches over several frames. The ID is
+	// hashed in integers, which keeps large IDs apart, and the top 24 bits map exactly onto [0, 1):
+	const uint32 phaseHash = static_cast<uint32>(InAnimInstance->GetUniqueID()) * 2654435761u;
+	UpdateTimer = 0.0f;
+	SearchAccumulator = GetSearchInterval() * (phaseHash >> 8) * (1.0f / 16777216.0f);
+}
+
+void FAnimNode_MotionMatching::PreUpdate(const UAnimInstance* InAnimInstance)
+{
+	if (!OwnerPawn || !SkeletalMeshComponent || !Database.IsValid())
+	{
+		return;
+	}
+
+	HistoryTime = InAnimInstance->GetWorld() ? InAnimInstance->GetWorld()->GetTimeSeconds() : 0.0f;
+	RecordRootHistory();
+
+	if (!TrajectoryComponent)
+	{
+		return;
+	}
+
+	// Points are relative to the character, along the axes of the component the database's root motion is expressed in:
+	const FTransform trajectorySpace{SkeletalMeshComponent->GetComponentQuat(), OwnerPawn->GetActorLocation()};
+	TrajectoryComponent->GetTrajectory(Database->FeatureDatabase.GetTrajectoryTimes(), trajectorySpace, TrajectoryPoints);
+	TrajectoryForward = trajectorySpace.InverseTransformVectorNoScale(OwnerPawn->GetActorForwardVector());
 }
 
 void FAnimNode_MotionMatching::Update_AnyThread(const FAnimationUpdateContext& Context)
@@ -29,10 +119,16 @@ void FAnimNode_MotionMatching::Update_AnyThread(const FAnimationUpdateContext& C
 
 	GlobalDeltaTime = deltaTime;
 	DebugTimer += deltaTime;
+	UpdateTimer += deltaTime;
+	SearchAccumulator += deltaTime;
+	BlendWeight = FMath::Max(BlendWeight - BlendWeightDecrement * deltaTime * BlendReferenceFrameRate, 0.0f);
+	LODLevel = (LODLevelOverride >= 0) ? LODLevelOverride : (Context.AnimInstanceProxy ? Context.AnimInstanceProxy->GetLODLevel() : 0);
+	Counters.Tick(deltaTime);
 
-	if (DebugTimer > DebugRate)
+	if (SearchExecution == EMotionMatchingSearchExecution::Async)
 	{
-		UpdateTimer += deltaTime;
+		LaunchAsyncSearch();
+		PendingSearchAge += deltaTime;
 	}
 }
 
@@ -45,87 +141,635 @@ void FAnimNode_MotionMatching::Evaluate_AnyThread(FPoseContext& Output)
 		return;
 	}
 
-	if (DebugTimer > DebugRate)
+	if (!Database.IsValid())
 	{
-		DebugTimer = 0.0f;
-		if (UpdateTimer > UpdateRate)
+		ensureMsgf(false, TEXT("Motion database was not built"));
+
+		return;
+	}
+
+	switch (SearchExecution)
+	{
+	case EMotionMatchingSearchExecution::Async:
+		CompleteAsyncSearch();
+		break;
+	case EMotionMatchingSearchExecution::CrowdBatched:
+		UpdateBatchedSearch();
+		break;
+	default:
+		if (ConsumeScheduledSearch())
 		{
-			PreviousAnimKey = NewAnimKey;
-			LowestCostAnimkey = FindLowestCostAnimKey();
-			UpdateTimer = 0.0f;
-			BlendWeight = 1.0f;
+			SearchLowestCostAnimKey();
+		}
+		break;
+	}
 
-			if(IsDebugMode)
-			{
-				const FVector& currentTrajectory = CalculateCurrentTrajectory();
-				DrawDebugTrajectory(currentTrajectory, FColor::Yellow);
-	
-				const FTransform& animTransform = AnimationContainer.ExtractRootMotion(LowestCostAnimkey, UpdateRate);
-				const FTransform& worldAnimTransform = SkeletalMeshComponent->ConvertLocalRootMotionToWorld(animTransform);
-				DrawDebugTrajectory(worldAnimTransform.GetTranslation(), FColor::Red);
-			}
+	// Playback and root motion follow the frame's delta time, whether or not a search ran:
+	NewAnimKey = LowestCostAnimkey;
+	NewAnimKey.StartTime += UpdateTimer;
+	MoveOwnerPawn();
+
+	const bool bIsInertializing = (TransitionMode == EMotionMatchingTransitionMode::Inertialization);
+
+	if (bIsInertializing)
+	{
+		AnimationContainer.DecayTransition(GlobalDeltaTime, InertializationHalfLife);
+	}
+
+	// The outgoing pose is sampled once, when the transition starts:
+	if (bIsTransitionPending)
+	{
+		AnimationContainer.StartTransition(Output, PreviousAnimKey, NewAnimKey, bIsInertializing ? 1.0f : OutgoingBlendWeight, bIsInertializing);
+		bIsTransitionPending = false;
+	}
+
+	if (bIsInertializing)
+	{
+		AnimationContainer.GetBlendedPose(Output, NewAnimKey, 1.0f);
+	}
+	else
+	{
+		AnimationContainer.GetBlendedPose(Output, NewAnimKey, BlendWeight);
+	}
+
+	RecordBoneHistory(Output);
+}
+
+const FMotionMatchingLODProfile* FAnimNode_MotionMatching::GetLODProfile() const
+{
+	return (LODProfiles.Num() > 0) ? &LODProfiles[FMath::Clamp(LODLevel, 0, LODProfiles.Num() - 1)] : nullptr;
+}
+
+float FAnimNode_MotionMatching::GetSearchInterval() const
+{
+	const FMotionMatchingLODProfile* lodProfile = GetLODProfile();
+
+	return (lodProfile && lodProfile->SearchInterval > 0.0f) ? lodProfile->SearchInterval : UpdateRate;
+}
+
+bool FAnimNode_MotionMatching::ConsumeScheduledSearch()
+{
+	const float searchInterval = GetSearchInterval();
+
+	if (SearchAccumulator < searchInterval)
+	{
+		return false;
+	}
+
+	if (!FMotionMatchingSearchBudget::Get().TryAcquire())
+	{
+		Counters.RecordDeferredSearch();
+
+		return false;
+	}
+
+	// A search answers the current input, so searches missed during a hitch are not made up one by one: at most one
+	// interval is carried over, which makes the next search due on the following frame.
+	SearchAccumulator = FMath::Min(SearchAccumulator - searchInterval, searchInterval);
+
+	return true;
+}
+
+void FAnimNode_MotionMatching::SearchLowestCostAnimKey()
+{
+	LastSearchStats = FMotionMatchingSearchStats{};
+	UpdateQueryFeatures();
+	UpdateQueryWeights();
+
+	FMotionMatchingSearchResult lowestCostResult;
+
+	if (TryContinueCurrentClip(lowestCostResult))
+	{
+		return;
+	}
+
+	const FMotionMatchingSearchResult initialResult = lowestCostResult;
+	const FMotionMatchingSearchSettings searchSettings = GetSearchSettings();
+	const uint64 startCycles = FPlatformTime::Cycles64();
+	MotionMatchingSearch::FindLowestCost(searchSettings, Database->FeatureDatabase, Database->SearchIndex, QueryFeatures.GetData(), QueryWeights.GetData(), lowestCostResult, LastSearchStats);
+	const float searchMicroseconds = FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - startCycles) * 1000.0;
+
+	RecordSearch(QueryFeatures, QueryWeights, searchSettings, initialResult, lowestCostResult, false, searchMicroseconds);
+	ApplySearchResult(lowestCostResult);
+}
+
+FMotionMatchingSearchSettings FAnimNode_MotionMatching::GetSearchSettings() const
+{
+	const FMotionMatchingLODProfile* lodProfile = GetLODProfile();
+	const EMotionMatchingSearchMode searchMode = (lodProfile && lodProfile->UseSearchMode) ? lodProfile->SearchMode : SearchMode;
+
+	return FMotionMatchingSearchSettings{searchMode, CostKernel, ApproximateCandidateBudget, ParallelSearchThreshold};
+}
+
+FAnimKey FAnimNode_MotionMatching::GetResultAnimKey(const FMotionMatchingSearchResult& Result) const
+{
+	if (Result.SampleIndex == INDEX_NONE)
+	{
+		return FAnimKey{};
+	}
+
+	return Database->FeatureDatabase.GetAnimKey(Result.SampleIndex);
+}
+
+void FAnimNode_MotionMatching::ApplySearchResult(const FMotionMatchingSearchResult& Result)
+{
+	Counters.RecordSearch(Result, LastSearchStats);
+
+	const FMotionFeatureDatabase& featureDatabase = Database->FeatureDatabase;
+	const int32 currentSampleIndex = featureDatabase.FindSampleIndex(NewAnimKey);
+
+	// Jumping a couple of frames within the clip already playing would only cost a blend:
+	const bool bIsNearbyFrame = UseContinuationBias
+		&& Result.SampleIndex != INDEX_NONE
+		&& currentSampleIndex != INDEX_NONE
+		&& featureDatabase.GetAnimationIndex(featureDatabase.GetAnimKey(Result.SampleIndex)) == featureDatabase.GetAnimationIndex(NewAnimKey)
+		&& FMath::Abs(Result.SampleIndex - currentSampleIndex) <= 2;
+
+	if (bIsNearbyFrame)
+	{
+		ContinueCurrentClip();
+	}
+	else
+	{
+		Counters.RecordMatchSwitch();
+		StartTransition(GetResultAnimKey(Result));
+	}
+}
+
+FMotionMatchingSearchResult FAnimNode_MotionMatching::ScoreContinuation() const
+{
+	FMotionMatchingSearchResult continuation;
+	const FMotionFeatureDatabase& featureDatabase = Database->FeatureDatabase;
+	const int32 currentSampleIndex = featureDatabase.FindSampleIndex(NewAnimKey);
+
+	if (!UseContinuationBias || currentSampleIndex == INDEX_NONE)
+	{
+		return continuation;
+	}
+
+	// A clip on its last sample has nothing left to continue with:
+	const int32 animationIndex = featureDatabase.GetAnimationIndex(NewAnimKey);
+	const int32 animationEndSample = featureDatabase.GetAnimationFirstSample(animationIndex) + featureDatabase.GetAnimationNumSamples(animationIndex);
+
+	if (currentSampleIndex + 1 >= animationEndSample)
+	{
+		return continuation;
+	}
+
+	continuation.SampleIndex = currentSampleIndex;
+	// Scored like the search it competes with, on the same kernel and storage:
+	continuation.Cost = MotionMatchingSearch::ComputeSampleCost(GetSearchSettings(), featureDatabase, Database->SearchIndex, currentSampleIndex, QueryFeatures.GetData(), QueryWeights.GetData());
+
+	return continuation;
+}
+
+bool FAnimNode_MotionMatching::TryContinueCurrentClip(FMotionMatchingSearchResult& OutContinuation)
+{
+	OutContinuation = ScoreContinuation();
+
+	if (OutContinuation.SampleIndex == INDEX_NONE || OutContinuation.Cost > ContinuationCostThreshold)
+	{
+		return false;
+	}
+
+	Counters.RecordSkippedSearch();
+	RecordSearch(QueryFeatures, QueryWeights, GetSearchSettings(), OutContinuation, OutContinuation, true);
+	ContinueCurrentClip();
+
+	return true;
+}
+
+void FAnimNode_MotionMatching::ContinueCurrentClip()
+{
+	LowestCostAnimkey.StartTime += UpdateTimer;
+	UpdateTimer = 0.0f;
+}
+
+FMotionMatchingSearchRequestPtr FAnimNode_MotionMatching::CreateSearchRequest()
+{
+	UpdateQueryFeatures();
+	UpdateQueryWeights();
+
+	// The continuation bounds the search, or makes it unnecessary:
+	FMotionMatchingSearchResult continuation;
+
+	if (TryContinueCurrentClip(continuation))
+	{
+		return nullptr;
+	}
+
+	const FMotionMatchingSearchRequestPtr request = MakeShared<FMotionMatchingSearchRequest, ESPMode::ThreadSafe>();
+	request->Database = Database;
+	request->Settings = GetSearchSettings();
+	request->Query = QueryFeatures;
+	request->Weights = QueryWeights;
+	request->Result = continuation;
+	PendingSearchInitialResult = continuation;
+
+	return request;
+}
+
+void FAnimNode_MotionMatching::UpdateBatchedSearch()
+{
+	// The current clip keeps playing until the batcher has answered, which happens once per frame:
+	if (!PendingSearchRequest.IsValid())
+	{
+		if (!ConsumeScheduledSearch())
+		{
+			return;
+		}
+
+		PendingSearchRequest = CreateSearchRequest();
+
+		if (PendingSearchRequest.IsValid())
+		{
+			FMotionMatchingCrowd::Get().Submit(PendingSearchRequest);
 		}
 
-		NewAnimKey = FAnimKey{ LowestCostAnimkey.Index, LowestCostAnimkey.StartTime + UpdateTimer };
-		MoveOwnerPawn();
+		return;
 	}
 
-	BlendWeight -= BlendWeightDecrement;
-	AnimationContainer.GetBlendedPose(Output, PreviousAnimKey, NewAnimKey, BlendWeight);
+	if (PendingSearchRequest->IsDone())
+	{
+		LastSearchStats = PendingSearchRequest->Stats;
+		RecordSearch(PendingSearchRequest->Query, PendingSearchRequest->Weights, PendingSearchRequest->Settings, PendingSearchInitialResult, PendingSearchRequest->Result, false);
+		ApplySearchResult(PendingSearchRequest->Result);
+		PendingSearchRequest.Reset();
+	}
 }
 
-FAnimKey FAnimNode_MotionMatching::FindLowestCostAnimKey()
+void FAnimNode_MotionMatching::LaunchAsyncSearch()
 {
-	float lowestAnimCost = BIG_NUMBER;
-	FAnimKey lowestCostAnimKey;
-	CurrentTrajectory = CalculateCurrentTrajectory();
+	if (PendingSearchRequest.IsValid() || !SkeletalMeshComponent || !Database.IsValid() || !ConsumeScheduledSearch())
+	{
+		return;
+	}
+
+	// The request keeps the query it was launched with, evaluation keeps playing the current clip meanwhile:
+	const FMotionMatchingSearchRequestPtr request = CreateSearchRequest();
 
-	for (AnimationContainer.ResetKey(); AnimationContainer.CurrentKey < AnimationContainer.MaxKey(); AnimationContainer.IncrementKey())
+	if (!request.IsValid())
 	{
-		float currentAnimCost = 0.0f;
-		const FTransform& rootMotion = AnimationContainer.ExtractRootMotion(AnimationContainer.CurrentKey, UpdateRate);
+		return;
+	}
+
+	PendingSearchRequest = request;
+	PendingSearchAge = 0.0f;
+	request->Task = Async(EAsyncExecution::TaskGraph, [request]()
+	{
+		request->TryExecute();
+	});
+}
+
+void FAnimNode_MotionMatching::CompleteAsyncSearch()
+{
+	if (!PendingSearchRequest.IsValid())
+	{
+		return;
+	}
 
-		if (TrajectoryWeight > 0)
+	if (!PendingSearchRequest->IsDone())
+	{
+		if (PendingSearchAge < MaxSearchLatency)
 		{
-			currentAnimCost += TrajectoryWeight * ComputeTrajectoryCost(rootMotion);
+			return;
 		}
 
-		if (PoseWeight > 0)
+		// A task still queued, possibly behind this very evaluation, is run here instead of waited for. Only a
+		// search already running on another thread is waited for:
+		if (!PendingSearchRequest->TryExecute())
 		{
-			currentAnimCost += PoseWeight * ComputePoseCost();
+			PendingSearchRequest->Wait();
 		}
+	}
+
+	LastSearchStats = PendingSearchRequest->Stats;
+	RecordSearch(PendingSearchRequest->Query, PendingSearchRequest->Weights, PendingSearchRequest->Settings, PendingSearchInitialResult, PendingSearchRequest->Result, false);
+	ApplySearchResult(PendingSearchRequest->Result);
+	PendingSearchRequest.Reset();
+}
+
+void FAnimNode_MotionMatching::StartRecording(const UAnimInstance* InAnimInstance)
+{
+	Recorder.Reset();
+
+	if ((!UseRecording && CVarMotionMatchingRecord.GetValueOnAnyThread() == 0) || !Database.IsValid())
+	{
+		return;
+	}
+
+	const FString& fileName = FString::Printf(TEXT("%s_%s.mmrec"), *InAnimInstance->GetName(), *FDateTime::Now().ToString());
+	const FString& path = FPaths::ConvertRelativePathToFull(FPaths::ProjectSavedDir(), FPaths::Combine(RecordingDirectory, fileName));
+	Recorder = MakeShared<FMotionMatchingRecorder, ESPMode::ThreadSafe>();
+
+	if (!Recorder->Open(path, *Database, GetSearchSettings()))
+	{
+		Recorder.Reset();
+	}
+}
+
+void FAnimNode_MotionMatching::RecordSearch(const TArray<float>& Query, const TArray<float>& Weights, const FMotionMatchingSearchSettings& Settings, const FMotionMatchingSearchResult& InitialResult, const FMotionMatchingSearchResult& Result, bool bSkipped, float SearchMicroseconds)
+{
+	if (!Recorder.IsValid())
+	{
+		return;
+	}
+
+	FMotionMatchingRecordedSearch search;
+	search.Time = HistoryTime;
+	search.Query = Query;
+	search.Weights = Weights;
+	search.SearchMode = Settings.SearchMode;
+	search.InitialResult = InitialResult;
+	search.Result = Result;
+	search.AnimKey = GetResultAnimKey(Result);
+	search.SearchMicroseconds = SearchMicroseconds;
+	search.bSkipped = bSkipped;
+	Recorder->Record(search);
+}
+
+void FAnimNode_MotionMatching::StartTransition(const FAnimKey& AnimKey)
+{
+	PreviousAnimKey = NewAnimKey;
+	LowestCostAnimkey = AnimKey;
+	UpdateTimer = 0.0f;
+
+	// The pose on screen keeps the blend weight it was drawn with until the transition is sampled in Evaluate:
+	if (!bIsTransitionPending)
+	{
+		OutgoingBlendWeight = BlendWeight;
+	}
+
+	// Without blending the new clip simply replaces the old one:
+	const FMotionMatchingLODProfile* lodProfile = GetLODProfile();
+	const bool bUseBlending = !lodProfile || lodProfile->UseBlending;
+	BlendWeight = bUseBlending ? 1.0f : 0.0f;
+	bIsTransitionPending = bUseBlending;
 
-		if (lowestAnimCost > currentAnimCost)
+	if (!bUseBlending)
+	{
+		AnimationContainer.ResetTransition();
+	}
+
+	if (IsDebugMode && DebugTimer > DebugRate)
+	{
+		DebugTimer = 0.0f;
+
+		const FVector& currentTrajectory = CalculateCurrentTrajectory();
+		DrawDebugTrajectory(currentTrajectory, FColor::Yellow);
+
+		// The chosen clip's root motion up to the furthest point the search matched:
+		const TArray<float>& trajectoryTimes = Database->FeatureDatabase.GetTrajectoryTimes();
+		const float debugDuration = (trajectoryTimes.Num() > 0) ? FMath::Max(trajectoryTimes.Last(), 0.0f) : UpdateRate;
+		const FTransform& animTransform = AnimationContainer.ExtractRootMotion(LowestCostAnimkey, debugDuration);
+		const FTransform& worldAnimTransform = SkeletalMeshComponent->ConvertLocalRootMotionToWorld(animTransform);
+		DrawDebugTrajectory(worldAnimTransform.GetTranslation(), FColor::Red);
+	}
+}
+
+void FAnimNode_MotionMatching::UpdateQueryFeatures()
+{
+	const FMotionFeatureDatabase& featureDatabase = Database->FeatureDatabase;
+	const int32 numTrajectoryPoints = featureDatabase.GetNumTrajectoryPoints();
+	QueryFeatures.SetNumUninitialized(featureDatabase.GetNumDimensions(), false);
+
+	if (QueryFeatures.Num() == 0)
+	{
+		return;
+	}
+
+	// Last frame's query is already normalized, nothing of it may be normalized a second time:
+	FMemory::Memzero(QueryFeatures.GetData(), QueryFeatures.Num() * sizeof(float));
+
+	// The facings unless the input changes them, and the pose until the history has it, describe the sample
+	// currently playing:
+	const int32 currentSampleIndex = featureDatabase.FindSampleIndex(NewAnimKey);
+
+	if (currentSampleIndex != INDEX_NONE)
+	{
+		FMemory::Memcpy(QueryFeatures.GetData(), featureDatabase.GetFeatures(currentSampleIndex), QueryFeatures.Num() * sizeof(float));
+		featureDatabase.DenormalizeFeatures(QueryFeatures.GetData(), featureDatabase.GetTrajectoryPositionsOffset(), featureDatabase.GetBonePositionsOffset());
+	}
+
+	UpdateQueryPoseFromHistory();
+
+	if (numTrajectoryPoints == 0)
+	{
+		return;
+	}
+
+	const int32 trajectoryOffset = featureDatabase.GetTrajectoryPositionsOffset();
+	const int32 facingsOffset = featureDatabase.GetTrajectoryFacingsOffset();
+
+	// Predicted points replace the raw input, facings are relative to the current one like the database's:
+	if (TrajectoryPoints.Num() == numTrajectoryPoints)
+	{
+		const float forwardYaw = FMath::Atan2(TrajectoryForward.Y, TrajectoryForward.X);
+
+		for (int32 pointIndex = 0; pointIndex < numTrajectoryPoints; ++pointIndex)
 		{
-			lowestAnimCost = currentAnimCost;
-			lowestCostAnimKey = AnimationContainer.CurrentKey;
+			const FMotionTrajectoryPoint& point = TrajectoryPoints[pointIndex];
+			const float facingYaw = FMath::Atan2(point.Facing.Y, point.Facing.X) - forwardYaw;
+			QueryFeatures[trajectoryOffset + 3 * pointIndex + 0] = point.Position.X;
+			QueryFeatures[trajectoryOffset + 3 * pointIndex + 1] = point.Position.Y;
+			QueryFeatures[trajectoryOffset + 3 * pointIndex + 2] = point.Position.Z;
+			QueryFeatures[facingsOffset + 2 * pointIndex + 0] = FMath::Cos(facingYaw);
+			QueryFeatures[facingsOffset + 2 * pointIndex + 1] = FMath::Sin(facingYaw);
 		}
 	}
-	
-	return lowestCostAnimKey;
+	else
+	{
+		UpdateQueryTrajectoryFromInput(currentSampleIndex);
+	}
+
+	// Past points come from where the character actually was, whichever way the future ones were built:
+	for (int32 pointIndex = 0; pointIndex < numTrajectoryPoints; ++pointIndex)
+	{
+		FTransform pastTransform;
+
+		if (featureDatabase.GetTrajectoryTime(pointIndex) < 0.0f && FindPastRootTransform(-featureDatabase.GetTrajectoryTime(pointIndex), pastTransform))
+		{
+			const FVector& pastPosition = CurrentRootSample.Transform.InverseTransformPosition(pastTransform.GetLocation());
+			const FVector& pastFacing = (CurrentRootSample.Transform.GetRotation().Inverse() * pastTransform.GetRotation()).GetForwardVector();
+			QueryFeatures[trajectoryOffset + 3 * pointIndex + 0] = pastPosition.X;
+			QueryFeatures[trajectoryOffset + 3 * pointIndex + 1] = pastPosition.Y;
+			QueryFeatures[trajectoryOffset + 3 * pointIndex + 2] = pastPosition.Z;
+			QueryFeatures[facingsOffset + 2 * pointIndex + 0] = pastFacing.X;
+			QueryFeatures[facingsOffset + 2 * pointIndex + 1] = pastFacing.Y;
+		}
+	}
+
+	featureDatabase.NormalizeFeatures(QueryFeatures.GetData(), trajectoryOffset, featureDatabase.GetBonePositionsOffset());
 }
 
-float FAnimNode_MotionMatching::ComputeTrajectoryCost(const FTransform& RootMotion) const 
+void FAnimNode_MotionMatching::UpdateQueryTrajectoryFromInput(int32 CurrentSampleIndex)
 {
-	const FTransform& worldAnimTransform = SkeletalMeshComponent->ConvertLocalRootMotionToWorld(RootMotion);
-	FVector animTranslation = worldAnimTransform.GetTranslation();
-	
-	return FVector::Dist(CurrentTrajectory, animTranslation);
+	const FMotionFeatureDatabase& featureDatabase = Database->FeatureDatabase;
+	const int32 numTrajectoryPoints = featureDatabase.GetNumTrajectoryPoints();
+	const int32 trajectoryOffset = featureDatabase.GetTrajectoryPositionsOffset();
+	const int32 facingsOffset = featureDatabase.GetTrajectoryFacingsOffset();
+
+	// The database stores root motion in component space, so the desired trajectory is brought into the same space:
+	const FVector& localTrajectory = SkeletalMeshComponent->GetComponentTransform().InverseTransformVector(CalculateCurrentTrajectory());
+	const float trajectoryDuration = featureDatabase.GetTrajectoryTime(numTrajectoryPoints - 1);
+
+	// The desired facings turn the current clip's ones by the angle between where it is heading and where the input
+	// asks to go:
+	const FVector2D currentHeading{QueryFeatures[trajectoryOffset + 3 * (numTrajectoryPoints - 1) + 0], QueryFeatures[trajectoryOffset + 3 * (numTrajectoryPoints - 1) + 1]};
+	const bool bTurnFacings = CurrentSampleIndex != INDEX_NONE && !currentHeading.IsNearlyZero() && !FVector2D{localTrajectory}.IsNearlyZero();
+	const float turnAngle = bTurnFacings ? FMath::Atan2(localTrajectory.Y, localTrajectory.X) - FMath::Atan2(currentHeading.Y, currentHeading.X) : 0.0f;
+
+	for (int32 pointIndex = 0; pointIndex < numTrajectoryPoints; ++pointIndex)
+	{
+		const float pointAlpha = (trajectoryDuration > 0.0f) ? featureDatabase.GetTrajectoryTime(pointIndex) / trajectoryDuration : 1.0f;
+		const FVector& pointPosition = localTrajectory * pointAlpha;
+		QueryFeatures[trajectoryOffset + 3 * pointIndex + 0] = pointPosition.X;
+		QueryFeatures[trajectoryOffset + 3 * pointIndex + 1] = pointPosition.Y;
+		QueryFeatures[trajectoryOffset + 3 * pointIndex + 2] = pointPosition.Z;
+
+		if (bTurnFacings)
+		{
+			const FVector2D& currentFacing = FVector2D{QueryFeatures[facingsOffset + 2 * pointIndex + 0], QueryFeatures[facingsOffset + 2 * pointIndex + 1]};
+			const FVector2D& facing = currentFacing.GetRotated(FMath::RadiansToDegrees(turnAngle * pointAlpha));
+			QueryFeatures[facingsOffset + 2 * pointIndex + 0] = facing.X;
+			QueryFeatures[facingsOffset + 2 * pointIndex + 1] = facing.Y;
+		}
+	}
 }
 
-float FAnimNode_MotionMatching::ComputePoseCost() const
+void FAnimNode_MotionMatching::UpdateQueryWeights()
 {
-	float Cost = 0.0f;
-		
-	for (const FName& boneName : BoneNames)
+	FMotionFeatureWeights featureWeights = GetFeatureWeights();
+	const FMotionMatchingLODProfile* lodProfile = GetLODProfile();
+
+	if (lodProfile && !lodProfile->UsePoseFeatures)
 	{
-		const FTransform& newBoneTransform = GetLoadedBoneToRootTransform(boneName, AnimationContainer.CurrentKey);
-		const FTransform& previousBoneTransform = GetLoadedBoneToRootTransform(boneName, PreviousAnimKey);
-	
-		Cost += FTransform::SubtractTranslations(newBoneTransform, previousBoneTransform).Size();
+		featureWeights.BonePositions = 0.0f;
+		featureWeights.BoneVelocities = 0.0f;
+	}
+
+	Database->FeatureDatabase.ExpandWeights(featureWeights, QueryWeights);
+}
+
+FMotionFeatureWeights FAnimNode_MotionMatching::GetFeatureWeights() const
+{
+	return FMotionFeatureWeights{TrajectoryWeight, OrientationWeight, PoseWeight, VelocityWeight};
+}
+
+void FAnimNode_MotionMatching::InitHistory()
+{
+	const TArray<FName>& databaseBoneNames = Database->FeatureDatabase.GetBoneNames();
+	const USkeletalMesh* skeletalMesh = SkeletalMeshComponent ? SkeletalMeshComponent->SkeletalMesh : nullptr;
+
+	RootHistory.Reset();
+	BoneHistories.Reset();
+	BoneHistories.SetNum(databaseBoneNames.Num());
+	HistoryBoneIndices.Reset();
+	LastBoneHistoryTime = -1.0f;
+
+	for (const FName& boneName : databaseBoneNames)
+	{
+		HistoryBoneIndices.Add(skeletalMesh ? skeletalMesh->RefSkeleton.FindBoneIndex(boneName) : INDEX_NONE);
 	}
+}
+
+void FAnimNode_MotionMatching::RecordRootHistory()
+{
+	CurrentRootSample.Transform = FTransform{SkeletalMeshComponent->GetComponentQuat(), OwnerPawn->GetActorLocation()};
+	CurrentRootSample.Time = HistoryTime;
+
+	FMotionRootSample newestSample;
 
-	return Cost;
+	if (!RootHistory.Get(0, newestSample) || HistoryTime - newestSample.Time >= RootHistoryInterval)
+	{
+		RootHistory.Push(CurrentRootSample);
+	}
+}
+
+void FAnimNode_MotionMatching::RecordBoneHistory(const FPoseContext& Output)
+{
+	if (HistoryBoneIndices.Num() == 0 || HistoryTime <= LastBoneHistoryTime)
+	{
+		return;
+	}
+
+	LastBoneHistoryTime = HistoryTime;
+
+	// Bones are recorded relative to the root, like the database's:
+	FCSPose<FCompactPose> componentSpacePose;
+	componentSpacePose.InitPose(Output.Pose);
+	const FBoneContainer& boneContainer = Output.Pose.GetBoneContainer();
+	const FTransform& rootTransform = componentSpacePose.GetComponentSpaceTransform(FCompactPoseBoneIndex{0});
+
+	for (int32 boneIndex = 0; boneIndex < HistoryBoneIndices.Num(); ++boneIndex)
+	{
+		if (HistoryBoneIndices[boneIndex] == INDEX_NONE)
+		{
+			continue;
+		}
+
+		const FCompactPoseBoneIndex compactBoneIndex = boneContainer.MakeCompactPoseIndex(FMeshPoseBoneIndex{HistoryBoneIndices[boneIndex]});
+
+		if (compactBoneIndex.IsValid())
+		{
+			const FVector& position = componentSpacePose.GetComponentSpaceTransform(compactBoneIndex).GetTranslation();
+			BoneHistories[boneIndex].Push(FMotionBoneSample{rootTransform.InverseTransformPosition(position), HistoryTime});
+		}
+	}
+}
+
+bool FAnimNode_MotionMatching::FindPastRootTransform(float TimeAgo, FTransform& OutTransform) const
+{
+	const float time = CurrentRootSample.Time - TimeAgo;
+	FMotionRootSample newerSample = CurrentRootSample;
+	FMotionRootSample olderSample;
+
+	for (int32 age = 0; RootHistory.Get(age, olderSample); ++age)
+	{
+		if (olderSample.Time <= time)
+		{
+			const float alpha = (newerSample.Time > olderSample.Time) ? (newerSample.Time - time) / (newerSample.Time - olderSample.Time) : 1.0f;
+			OutTransform.Blend(newerSample.Transform, olderSample.Transform, alpha);
+
+			return true;
+		}
+
+		newerSample = olderSample;
+	}
+
+	return false;
+}
+
+void FAnimNode_MotionMatching::UpdateQueryPoseFromHistory()
+{
+	const FMotionFeatureDatabase& featureDatabase = Database->FeatureDatabase;
+	const int32 bonePositionsOffset = featureDatabase.GetBonePositionsOffset();
+	const int32 boneVelocitiesOffset = featureDatabase.GetBoneVelocitiesOffset();
+
+	// Bones without two recorded frames keep the features of the sample currently playing:
+	for (int32 boneIndex = 0; boneIndex < BoneHistories.Num() && boneIndex < featureDatabase.GetNumBones(); ++boneIndex)
+	{
+		FMotionBoneSample newestSample;
+		FMotionBoneSample previousSample;
+
+		if (!BoneHistories[boneIndex].Get(0, newestSample) || !BoneHistories[boneIndex].Get(1, previousSample) || newestSample.Time <= previousSample.Time)
+		{
+			continue;
+		}
+
+		const FVector& velocity = (newestSample.Position - previousSample.Position) / (newestSample.Time - previousSample.Time);
+		float* bonePosition = &QueryFeatures[bonePositionsOffset + 3 * boneIndex];
+		float* boneVelocity = &QueryFeatures[boneVelocitiesOffset + 3 * boneIndex];
+
+		bonePosition[0] = newestSample.Position.X;
+		bonePosition[1] = newestSample.Position.Y;
+		bonePosition[2] = newestSample.Position.Z;
+		boneVelocity[0] = velocity.X;
+		boneVelocity[1] = velocity.Y;
+		boneVelocity[2] = velocity.Z;
+		featureDatabase.NormalizeFeatures(QueryFeatures.GetData(), bonePositionsOffset + 3 * boneIndex, 3);
+		featureDatabase.NormalizeFeatures(QueryFeatures.GetData(), boneVelocitiesOffset + 3 * boneIndex, 3);
+	}
 }
 
 FVector FAnimNode_MotionMatching::CalculateCurrentTrajectory() const
@@ -160,7 +804,10 @@ void FAnimNode_MotionMatching::MoveOwnerPawn() const
 		return;
 	}
 	
-	const FTransform& blendedRootMotion = AnimationContainer.ExtractBlendedRootMotion(PreviousAnimKey, NewAnimKey, BlendWeight, GlobalDeltaTime);
+	// An inertialization only smooths the pose, the character moves with the incoming clip right away:
+	const FTransform& blendedRootMotion = (TransitionMode == EMotionMatchingTransitionMode::Inertialization)
+		? AnimationContainer.ExtractRootMotion(NewAnimKey, GlobalDeltaTime)
+		: AnimationContainer.ExtractBlendedRootMotion(PreviousAnimKey, NewAnimKey, BlendWeight, GlobalDeltaTime);
 
 	UCharacterMovementComponent* ownerPawnMovementComponent = Cast<UCharacterMovementComponent>(OwnerPawn->GetMovementComponent());
 		
@@ -171,23 +818,6 @@ void FAnimNode_MotionMatching::MoveOwnerPawn() const
 	}
 }
 
-void FAnimNode_MotionMatching::LoadBoneToRootTransforms()
-{
-	for (UAnimSequence* animationSequence : AnimationsArray)
-	{
-		BoneToRootTransformsArray.Emplace(FBoneToRootTransforms{SkeletalMeshComponent, animationSequence, AnimationSampling});
-	}
-}
-
-FTransform FAnimNode_MotionMatching::GetLoadedBoneToRootTransform(const FName& BoneName, const FAnimKey& AnimKey) const
-{
-	const FBoneToRootTransforms& boneToRootTransforms = BoneToRootTransformsArray[AnimKey.Index];
-	const int32 boneIndex = SkeletalMeshComponent->GetBoneIndex(BoneName);
-	const int32 keyIndex = static_cast<int32>(AnimKey.StartTime / AnimationSampling);
-
-	return boneToRootTransforms.GetTransform(boneIndex, keyIndex);
-}
-
 void FAnimNode_MotionMatching::DrawDebugTrajectory(const FVector& Trajectory, const FColor& Color) const
 {
 	if (!World || !SkeletalMeshComponent)
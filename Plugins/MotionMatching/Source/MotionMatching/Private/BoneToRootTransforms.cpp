@@ -1,97 +1,136 @@
 #include "BoneToRootTransforms.h"
 #include "Animation/AnimSequence.h"
-#include "Components/SkeletalMeshComponent.h"
+#include "Animation/AnimCurveTypes.h"
+#include "BonePose.h"
 
-FBoneToRootTransforms::FBoneToRootTransforms(class USkeletalMeshComponent* InSkeletalMeshComponent, UAnimSequence* InAnimSequence, float InAnimationSampling)
+FBoneToRootTransforms::FBoneToRootTransforms(const UAnimSequence* InAnimSequence, const TArray<int32>& InBoneIndices, float InAnimationSampling, bool bInComputeVelocities)
+	: BoneIndices(InBoneIndices)
 {
-	if (InSkeletalMeshComponent)
+	if (!InAnimSequence || InAnimationSampling <= 0.0f)
 	{
-		FootLeftIndex = InSkeletalMeshComponent->GetBoneIndex(FName(TEXT("foot_l")));
-		FootRightIndex = InSkeletalMeshComponent->GetBoneIndex(FName(TEXT("foot_r")));
-		HeadIndex = InSkeletalMeshComponent->GetBoneIndex(FName(TEXT("head")));
-		HandLeftIndex = InSkeletalMeshComponent->GetBoneIndex(FName(TEXT("hand_l")));
-		HandRightIndex = InSkeletalMeshComponent->GetBoneIndex(FName(TEXT("hand_r")));
-		PelvisIndex = InSkeletalMeshComponent->GetBoneIndex(FName(TEXT("pelvis")));
+		ensureMsgf(false, TEXT("Bone to root transforms need an animation and a sampling greater than zero"));
+
+		return;
 	}
 
-	if (InAnimSequence)
+	LoadTranslations(InAnimSequence, InAnimationSampling);
+
+	if (bInComputeVelocities)
 	{
-		LoadBoneToRootTransforms(InAnimSequence, InAnimationSampling);
+		CalculateVelocities(InAnimationSampling);
 	}
 }
 
-FTransform FBoneToRootTransforms::GetTransform(int32 BoneIndex, int32 KeyIndex) const
+void FBoneToRootTransforms::ResolveBoneIndices(const FReferenceSkeleton& InRefSkeleton, const TArray<FName>& InBoneNames, TArray<int32>& OutBoneIndices)
 {
-	if (!FootLeft.IsValidIndex(KeyIndex))
-	{
-		ensureMsgf(false, TEXT("Current key index does not match any preloaded bone to root transform"));
+	OutBoneIndices.Reset(InBoneNames.Num());
 
-		return FTransform::Identity;
-	}
-
-	if (BoneIndex == FootLeftIndex)
-	{
-		return FootLeft[KeyIndex];
-	}
-	else if (BoneIndex == FootRightIndex)
-	{
-		return FootRight[KeyIndex];
-	}
-	else if (BoneIndex == HeadIndex)
+	for (const FName& boneName : InBoneNames)
 	{
-		return Head[KeyIndex];
+		OutBoneIndices.Add(InRefSkeleton.FindBoneIndex(boneName));
 	}
-	else if (BoneIndex == HandLeftIndex)
-	{
-		return HandLeft[KeyIndex];
-	}
-	else if (BoneIndex == HandRightIndex)
+}
+
+void FBoneToRootTransforms::LoadTranslations(const UAnimSequence* InAnimSequence, float InAnimationSampling)
+{
+	USkeleton* skeleton = InAnimSequence->GetSkeleton();
+
+	if (!skeleton)
 	{
-		return HandRight[KeyIndex];
+		ensureMsgf(false, TEXT("Animation %s has no skeleton"), *InAnimSequence->GetName());
+
+		return;
 	}
-	else if (BoneIndex == PelvisIndex)
+
+	// Only the requested bones and their ancestors are extracted, in skeleton order so parents come before children:
+	TArray<FBoneIndexType> requiredBones;
+	GatherRequiredBones(skeleton->GetReferenceSkeleton(), requiredBones);
+
+	FBoneContainer boneContainer;
+	boneContainer.InitializeTo(requiredBones, FCurveEvaluationOption{false}, *skeleton);
+
+	TArray<FCompactPoseBoneIndex> compactBoneIndices;
+	for (const int32 boneIndex : BoneIndices)
 	{
-		return Pelvis[KeyIndex];
+		compactBoneIndices.Add(boneIndex == INDEX_NONE ? FCompactPoseBoneIndex{INDEX_NONE} : boneContainer.MakeCompactPoseIndex(FMeshPoseBoneIndex{boneIndex}));
 	}
 
-	return FTransform::Identity;
-}
+	FCompactPose pose;
+	pose.SetBoneContainer(&boneContainer);
+	FBlendedCurve curve;
+	curve.InitFrom(boneContainer);
+	TArray<FTransform> componentSpaceTransforms;
+	componentSpaceTransforms.SetNumUninitialized(pose.GetNumBones());
 
-void FBoneToRootTransforms::LoadBoneToRootTransforms(UAnimSequence* InAnimSequence, float InAnimationSampling)
-{
 	const float animLength = InAnimSequence->SequenceLength;
 
 	for (float animTime = 0.0f; animTime < animLength; animTime += InAnimationSampling)
 	{
-		FootLeft.Emplace(CalculateBoneToRootTransform(InAnimSequence, animTime, FootLeftIndex));
-		FootRight.Emplace(CalculateBoneToRootTransform(InAnimSequence, animTime, FootRightIndex));
-		Head.Emplace(CalculateBoneToRootTransform(InAnimSequence, animTime, HeadIndex));
-		HandLeft.Emplace(CalculateBoneToRootTransform(InAnimSequence, animTime, HandLeftIndex));
-		HandRight.Emplace(CalculateBoneToRootTransform(InAnimSequence, animTime, HandRightIndex));
-		Pelvis.Emplace(CalculateBoneToRootTransform(InAnimSequence, animTime, PelvisIndex));
+		// One decompression per sample, then a single pass accumulating component space transforms for all bones:
+		InAnimSequence->GetAnimationPose(pose, curve, FAnimExtractContext{animTime});
+
+		for (const FCompactPoseBoneIndex boneIndex : pose.ForEachBoneIndex())
+		{
+			const FCompactPoseBoneIndex parentIndex = boneContainer.GetParentBoneIndex(boneIndex);
+			componentSpaceTransforms[boneIndex.GetInt()] = parentIndex.IsValid() ? pose[boneIndex] * componentSpaceTransforms[parentIndex.GetInt()] : pose[boneIndex];
+		}
+
+		for (const FCompactPoseBoneIndex compactBoneIndex : compactBoneIndices)
+		{
+			Translations.Emplace(compactBoneIndex.IsValid() ? componentSpaceTransforms[compactBoneIndex.GetInt()].GetTranslation() : FVector::ZeroVector);
+		}
+
+		++NumSamples;
 	}
 }
 
-FTransform FBoneToRootTransforms::CalculateBoneToRootTransform(const UAnimSequence * InSequence, const float AnimTime, int32 BoneIndex)
+void FBoneToRootTransforms::CalculateVelocities(float InAnimationSampling)
 {
-	FTransform animBoneToRootTransform = FTransform::Identity;
-	const USkeleton* SourceSkeleton = InSequence->GetSkeleton();
-	FReferenceSkeleton RefSkel = SourceSkeleton->GetReferenceSkeleton();
+	Velocities.SetNumZeroed(Translations.Num());
 
-	if (RefSkel.IsValidIndex(BoneIndex))
+	// Central differences of the sampled translations (one-sided at the clip boundaries):
+	for (int32 sampleIndex = 0; sampleIndex < NumSamples; ++sampleIndex)
 	{
-		InSequence->GetBoneTransform(animBoneToRootTransform, BoneIndex, AnimTime, false);
+		const int32 previousSample = FMath::Max(sampleIndex - 1, 0);
+		const int32 nextSample = FMath::Min(sampleIndex + 1, NumSamples - 1);
 
-		while (RefSkel.GetParentIndex(BoneIndex) != INDEX_NONE)
+		if (previousSample == nextSample)
 		{
-			const int parentIndex = RefSkel.GetParentIndex(BoneIndex);
-			FTransform parentBoneTransform;
-			InSequence->GetBoneTransform(parentBoneTransform, parentIndex, AnimTime, false);
+			continue;
+		}
+
+		const FVector* previousTranslations = GetSampleTranslations(previousSample);
+		const FVector* nextTranslations = GetSampleTranslations(nextSample);
+		FVector* velocities = Velocities.GetData() + sampleIndex * GetNumBones();
+		const float inverseDeltaTime = 1.0f / ((nextSample - previousSample) * InAnimationSampling);
+
+		for (int32 boneIndex = 0; boneIndex < GetNumBones(); ++boneIndex)
+		{
+			velocities[boneIndex] = (nextTranslations[boneIndex] - previousTranslations[boneIndex]) * inverseDeltaTime;
+		}
+	}
+}
+
+void FBoneToRootTransforms::GatherRequiredBones(const FReferenceSkeleton& InRefSkeleton, TArray<FBoneIndexType>& OutRequiredBones) const
+{
+	TBitArray<> isRequired{false, InRefSkeleton.GetNum()};
 
-			animBoneToRootTransform = animBoneToRootTransform * parentBoneTransform;
-			BoneIndex = parentIndex;
+	for (int32 boneIndex : BoneIndices)
+	{
+		while (InRefSkeleton.IsValidIndex(boneIndex) && !isRequired[boneIndex])
+		{
+			isRequired[boneIndex] = true;
+			boneIndex = InRefSkeleton.GetParentIndex(boneIndex);
 		}
 	}
 
-	return animBoneToRootTransform;
-}
\ No newline at end of file
+	OutRequiredBones.Reset();
+
+	for (int32 boneIndex = 0; boneIndex < InRefSkeleton.GetNum(); ++boneIndex)
+	{
+		if (isRequired[boneIndex])
+		{
+			OutRequiredBones.Add(static_cast<FBoneIndexType>(boneIndex));
+		}
+	}
+}
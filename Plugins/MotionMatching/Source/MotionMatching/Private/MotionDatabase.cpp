@@ -0,0 +1,218 @@
+#include "MotionDatabase.h"
+#include "MotionMatchingStats.h"
+#include "Animation/AnimSequence.h"
+#include "Animation/Skeleton.h"
+#include "Misc/Crc.h"
+#include "Misc/ScopeLock.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+
+bool operator==(const FMotionDatabaseSettings& Lhs, const FMotionDatabaseSettings& Rhs)
+{
+	return (Lhs.Animations == Rhs.Animations)
+		&& (Lhs.Skeleton == Rhs.Skeleton)
+		&& (Lhs.BoneNames == Rhs.BoneNames)
+		&& (Lhs.AnimationSampling == Rhs.AnimationSampling)
+		&& (Lhs.TrajectoryTimes == Rhs.TrajectoryTimes)
+		&& (Lhs.SearchMode == Rhs.SearchMode)
+		&& (Lhs.AdditionalSearchModes == Rhs.AdditionalSearchModes)
+		&& (Lhs.IndexWeights == Rhs.IndexWeights)
+		&& (Lhs.Quantization == Rhs.Quantization)
+		&& (Lhs.MirrorAxis == Rhs.MirrorAxis)
+		&& (Lhs.MirrorBonePairs == Rhs.MirrorBonePairs)
+		&& (Lhs.SourceHash == Rhs.SourceHash);
+}
+
+uint32 GetTypeHash(const FMotionDatabaseSettings& Settings)
+{
+	uint32 hash = GetTypeHash(Settings.Skeleton);
+	hash = HashCombine(hash, GetTypeHash(Settings.AnimationSampling));
+	hash = HashCombine(hash, GetTypeHash(static_cast<uint8>(Settings.SearchMode)));
+	hash = HashCombine(hash, GetTypeHash(static_cast<uint8>(Settings.Quantization)));
+	hash = HashCombine(hash, GetTypeHash(static_cast<uint8>(Settings.MirrorAxis)));
+	hash = HashCombine(hash, GetTypeHash(Settings.SourceHash));
+
+	for (const UAnimSequence* animation : Settings.Animations)
+	{
+		hash = HashCombine(hash, GetTypeHash(animation));
+	}
+
+	for (const FName& boneName : Settings.BoneNames)
+	{
+		hash = HashCombine(hash, GetTypeHash(boneName));
+	}
+
+	for (const float trajectoryTime : Settings.TrajectoryTimes)
+	{
+		hash = HashCombine(hash, GetTypeHash(trajectoryTime));
+	}
+
+	for (const EMotionMatchingSearchMode searchMode : Settings.AdditionalSearchModes)
+	{
+		hash = HashCombine(hash, GetTypeHash(static_cast<uint8>(searchMode)));
+	}
+
+	return hash;
+}
+
+uint32 FMotionDatabaseSettings::CalculateSourceHash() const
+{
+	uint32 hash = 0;
+
+#if WITH_EDITORONLY_DATA
+	for (const UAnimSequence* animation : Animations)
+	{
+		if (animation)
+		{
+			hash = FCrc::MemCrc32(&animation->RawDataGuid, sizeof(FGuid), hash);
+		}
+	}
+#endif //WITH_EDITORONLY_DATA
+
+	return hash;
+}
+
+FMotionDatabase::~FMotionDatabase()
+{
+	DEC_MEMORY_STAT_BY(STAT_MotionMatchingDatabaseMemory, TrackedMemory);
+}
+
+void FMotionDatabase::Build(const FMotionDatabaseSettings& Settings)
+{
+	SCOPE_CYCLE_COUNTER(STAT_MotionMatchingDatabaseBuild);
+	TRACE_CPUPROFILER_EVENT_SCOPE(MotionMatchingDatabaseBuild);
+
+	MirrorTable.Reset();
+	SourceHash = Settings.CalculateSourceHash();
+
+	if (Settings.Skeleton)
+	{
+		MirrorTable.Build(Settings.Skeleton->GetReferenceSkeleton(), Settings.MirrorBonePairs, Settings.MirrorAxis);
+	}
+
+	FeatureDatabase.Build(Settings.Animations, Settings.Skeleton, Settings.BoneNames, Settings.AnimationSampling, Settings.TrajectoryTimes, MirrorTable);
+	BuildSearchData(Settings);
+}
+
+void FMotionDatabase::BuildFromFeatures(const FMotionDatabaseSettings& Settings, const TArray<float>& Features, const TArray<int32>& AnimationNumSamples)
+{
+	SCOPE_CYCLE_COUNTER(STAT_MotionMatchingDatabaseBuild);
+	TRACE_CPUPROFILER_EVENT_SCOPE(MotionMatchingDatabaseBuild);
+
+	MirrorTable.Reset();
+	FeatureDatabase.BuildFromFeatures(Features, AnimationNumSamples, Settings.BoneNames, Settings.AnimationSampling, Settings.TrajectoryTimes);
+	BuildSearchData(Settings);
+}
+
+void FMotionDatabase::BuildSearchData(const FMotionDatabaseSettings& Settings)
+{
+	// Quantized first, so that the AABB boxes bound the values the kernels scan. The other indices read the float rows:
+	FeatureDatabase.Quantize(Settings.Quantization);
+
+	TArray<float> indexWeights;
+	FeatureDatabase.ExpandWeights(Settings.IndexWeights, indexWeights);
+	TArray<EMotionMatchingSearchMode> searchModes{Settings.AdditionalSearchModes};
+	searchModes.AddUnique(Settings.SearchMode);
+	SearchIndex.Build(FeatureDatabase, indexWeights.GetData(), searchModes);
+	UpdateMemoryStat();
+}
+
+void FMotionDatabase::Serialize(FArchive& Ar)
+{
+	FeatureDatabase.Serialize(Ar);
+	MirrorTable.Serialize(Ar);
+	SearchIndex.Serialize(Ar);
+
+	if (Ar.IsLoading())
+	{
+		UpdateMemoryStat();
+	}
+}
+
+SIZE_T FMotionDatabase::GetAllocatedSize() const
+{
+	return FeatureDatabase.GetAllocatedSize() + MirrorTable.GetAllocatedSize() + SearchIndex.GetAllocatedSize();
+}
+
+void FMotionDatabase::UpdateMemoryStat()
+{
+	DEC_MEMORY_STAT_BY(STAT_MotionMatchingDatabaseMemory, TrackedMemory);
+	TrackedMemory = GetAllocatedSize();
+	INC_MEMORY_STAT_BY(STAT_MotionMatchingDatabaseMemory, TrackedMemory);
+}
+
+FMotionDatabaseCache& FMotionDatabaseCache::Get()
+{
+	static FMotionDatabaseCache cache;
+
+	return cache;
+}
+
+FMotionDatabasePtr FMotionDatabaseCache::FindOrBuild(const FMotionDatabaseSettings& Settings)
+{
+	// Keyed on the clips' current data as well, a reimported clip gets a new database even while nodes still use
+	// the one built before:
+	FMotionDatabaseSettings key{Settings};
+	key.SourceHash = Settings.CalculateSourceHash();
+
+	// Only created by the node that builds, an unfulfilled promise is an error:
+	TUniquePtr<TPromise<FMotionDatabasePtr>> promise;
+	TSharedFuture<FMotionDatabasePtr> pendingBuild;
+
+	{
+		FScopeLock scopeLock{&CriticalSection};
+
+		if (const TWeakPtr<const FMotionDatabase, ESPMode::ThreadSafe>* cachedDatabase = Databases.Find(key))
+		{
+			if (const FMotionDatabasePtr database = cachedDatabase->Pin())
+			{
+				return database;
+			}
+		}
+
+		if (const TSharedFuture<FMotionDatabasePtr>* otherBuild = PendingBuilds.Find(key))
+		{
+			pendingBuild = *otherBuild;
+		}
+		else
+		{
+			// Released databases are dropped here, so the cache never outgrows the set of databases in use:
+			for (auto it = Databases.CreateIterator(); it; ++it)
+			{
+				if (!it.Value().IsValid())
+				{
+					it.RemoveCurrent();
+				}
+			}
+
+			promise = MakeUnique<TPromise<FMotionDatabasePtr>>();
+			PendingBuilds.Add(key, promise->GetFuture().Share());
+		}
+	}
+
+	// Another node is building the same database, it is waited for without holding the lock:
+	if (pendingBuild.IsValid())
+	{
+		return pendingBuild.Get();
+	}
+
+	const TSharedRef<FMotionDatabase, ESPMode::ThreadSafe> database = MakeShared<FMotionDatabase, ESPMode::ThreadSafe>();
+	database->Build(key);
+
+	{
+		FScopeLock scopeLock{&CriticalSection};
+		Databases.Add(key, database);
+		PendingBuilds.Remove(key);
+	}
+
+	promise->SetValue(database);
+
+	return database;
+}
+
+void FMotionDatabaseCache::Reset()
+{
+	FScopeLock scopeLock{&CriticalSection};
+
+	// Builds in flight still publish their database to the nodes waiting for it:
+	Databases.Reset();
+}
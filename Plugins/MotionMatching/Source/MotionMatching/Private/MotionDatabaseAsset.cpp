@@ -0,0 +1,173 @@
+#include "MotionDatabaseAsset.h"
+#include "MotionMatching.h"
+#include "Animation/AnimSequence.h"
+#include "Animation/Skeleton.h"
+#include "Misc/Crc.h"
+#include "Serialization/MemoryWriter.h"
+
+void UMotionDatabaseAsset::Serialize(FArchive& Ar)
+{
+	Super::Serialize(Ar);
+
+	// Only package saves and loads carry the bake, transactions and reference collection skip it:
+	if (!Ar.IsPersistent() || Ar.IsTransacting() || Ar.IsObjectReferenceCollector() || Ar.IsCountingMemory())
+	{
+		return;
+	}
+
+	int32 version = FMotionDatabase::SerializationVersion;
+	uint32 sourceHash = 0;
+	int64 bakedSize = 0;
+
+	if (Ar.IsSaving())
+	{
+		// A bake loaded before its clips were reimported would otherwise be saved again under the new clips' hash:
+		if (BakedDatabase.IsValid() && !IsBakeUpToDate())
+		{
+			BakedDatabase.Reset();
+		}
+
+		// The database is staged first so that loading can skip a bake it cannot use without parsing it:
+		TArray<uint8> bakedData;
+		FMemoryWriter bakedDataWriter{bakedData, true};
+		const FMotionDatabasePtr database = GetDatabase();
+		const_cast<FMotionDatabase&>(*database).Serialize(bakedDataWriter);
+
+		BakedSettingsHash = CalculateSettingsHash();
+		sourceHash = database->SourceHash;
+		bakedSize = bakedData.Num();
+
+		Ar << version << BakedSettingsHash << sourceHash << bakedSize;
+		Ar.Serialize(bakedData.GetData(), bakedSize);
+	}
+	else if (Ar.IsLoading())
+	{
+		Ar << version << BakedSettingsHash << sourceHash << bakedSize;
+		const int64 bakedDataEnd = Ar.Tell() + bakedSize;
+		BakedDatabase.Reset();
+
+		if (version == FMotionDatabase::SerializationVersion)
+		{
+			const TSharedRef<FMotionDatabase, ESPMode::ThreadSafe> database = MakeShared<FMotionDatabase, ESPMode::ThreadSafe>();
+			database->Serialize(Ar);
+			database->SourceHash = sourceHash;
+
+			if (Ar.Tell() == bakedDataEnd && !Ar.IsError())
+			{
+				BakedDatabase = database;
+			}
+		}
+
+		Ar.Seek(bakedDataEnd);
+	}
+}
+
+void UMotionDatabaseAsset::PostLoad()
+{
+	Super::PostLoad();
+
+	if (!BakedDatabase.IsValid())
+	{
+		return;
+	}
+
+	// Referenced clips are only guaranteed to be loaded here, so the bake is validated after serialization:
+	if (!IsBakeUpToDate())
+	{
+		UE_LOG(LogMotionMatching, Warning, TEXT("Baked motion database of %s is out of date and will be rebuilt at runtime, resave the asset to update it"), *GetPathName());
+		BakedDatabase.Reset();
+	}
+}
+
+#if WITH_EDITOR
+void UMotionDatabaseAsset::PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent)
+{
+	Super::PostEditChangeProperty(PropertyChangedEvent);
+
+	BakedDatabase.Reset();
+}
+#endif //WITH_EDITOR
+
+FMotionDatabaseSettings UMotionDatabaseAsset::GetSettings() const
+{
+	FMotionDatabaseSettings settings;
+	settings.Animations = AnimationsArray;
+	settings.Skeleton = Skeleton;
+	settings.BoneNames = BoneNames;
+	settings.BoneNames.Remove(NAME_None);
+	settings.AnimationSampling = AnimationSampling;
+	settings.TrajectoryTimes = TrajectoryTimes;
+	settings.SearchMode = SearchMode;
+	settings.AdditionalSearchModes = AdditionalSearchModes;
+	settings.Quantization = Quantization;
+	settings.MirrorAxis = UseMirroring ? MirrorAxis.GetValue() : EAxis::None;
+	settings.MirrorBonePairs = MirrorBonePairs;
+	settings.IndexWeights = FMotionFeatureWeights{TrajectoryWeight, OrientationWeight, PoseWeight, VelocityWeight};
+
+	return settings;
+}
+
+FMotionDatabasePtr UMotionDatabaseAsset::GetDatabase() const
+{
+	// In the editor clips can be reimported while the asset stays loaded:
+#if WITH_EDITOR
+	if (BakedDatabase.IsValid() && (BakedDatabase->SourceHash == GetSettings().CalculateSourceHash()))
+#else
+	if (BakedDatabase.IsValid())
+#endif //WITH_EDITOR
+	{
+		return BakedDatabase;
+	}
+
+	return FMotionDatabaseCache::Get().FindOrBuild(GetSettings());
+}
+
+uint32 UMotionDatabaseAsset::CalculateSettingsHash() const
+{
+	const FMotionDatabaseSettings& settings = GetSettings();
+	const uint8 searchMode = static_cast<uint8>(settings.SearchMode);
+	const uint8 quantization = static_cast<uint8>(settings.Quantization);
+	const uint8 mirrorAxis = static_cast<uint8>(settings.MirrorAxis);
+
+	uint32 hash = FCrc::StrCrc32(Skeleton ? *Skeleton->GetPathName() : TEXT("None"));
+
+	for (const UAnimSequence* animation : settings.Animations)
+	{
+		hash = FCrc::StrCrc32(animation ? *animation->GetPathName() : TEXT("None"), hash);
+	}
+
+	for (const FName& boneName : settings.BoneNames)
+	{
+		hash = FCrc::StrCrc32(*boneName.ToString(), hash);
+	}
+
+	hash = FCrc::MemCrc32(&settings.AnimationSampling, sizeof(settings.AnimationSampling), hash);
+	hash = FCrc::MemCrc32(settings.TrajectoryTimes.GetData(), settings.TrajectoryTimes.Num() * sizeof(float), hash);
+	hash = FCrc::MemCrc32(&searchMode, sizeof(searchMode), hash);
+	hash = FCrc::MemCrc32(settings.AdditionalSearchModes.GetData(), settings.AdditionalSearchModes.Num() * sizeof(EMotionMatchingSearchMode), hash);
+	hash = FCrc::MemCrc32(&quantization, sizeof(quantization), hash);
+	hash = FCrc::MemCrc32(&mirrorAxis, sizeof(mirrorAxis), hash);
+
+	for (const FMotionMirrorBonePair& bonePair : settings.MirrorBonePairs)
+	{
+		hash = FCrc::StrCrc32(*bonePair.BoneName.ToString(), hash);
+		hash = FCrc::StrCrc32(*bonePair.MirroredBoneName.ToString(), hash);
+	}
+	hash = FCrc::MemCrc32(&settings.IndexWeights, sizeof(settings.IndexWeights), hash);
+
+	return hash;
+}
+
+bool UMotionDatabaseAsset::IsBakeUpToDate() const
+{
+	if (!BakedDatabase.IsValid() || (BakedSettingsHash != CalculateSettingsHash()))
+	{
+		return false;
+	}
+
+#if WITH_EDITOR
+	return BakedDatabase->SourceHash == GetSettings().CalculateSourceHash();
+#else
+	return true;
+#endif //WITH_EDITOR
+}
@@ -0,0 +1,155 @@
+#include "MotionFeatureAABBTree.h"
+#include "MotionFeatureDatabase.h"
+
+namespace
+{
+	// Every term is computed like the matching term in the cost kernels and is never larger than it for any sample
+	// inside the box, so the bound never exceeds a real cost and pruning with a strict comparison is exact.
+	float ComputeLowerBound(const float* Bounds, const MotionMatchingCostKernel::FActiveDimensions& Active, int32 NumDimensions)
+	{
+		const float* minimums = Bounds;
+		const float* maximums = Bounds + NumDimensions;
+		float bound = 0.0f;
+
+		for (int32 activeIndex = 0; activeIndex < Active.Num(); ++activeIndex)
+		{
+			const int32 dimension = Active.Dimensions[activeIndex];
+			const float query = Active.Query[activeIndex];
+			const float difference = query - FMath::Clamp(query, minimums[dimension], maximums[dimension]);
+			float term = difference * difference;
+			term = term * Active.Weights[activeIndex];
+			bound = bound + term;
+		}
+
+		return bound;
+	}
+}
+
+void FMotionFeatureAABBTree::Build(const FMotionFeatureDatabase& Database)
+{
+	Reset();
+
+	for (int32 animationIndex = 0; animationIndex < Database.GetNumAnimations(); ++animationIndex)
+	{
+		const int32 firstSample = Database.GetAnimationFirstSample(animationIndex);
+		const int32 endSample = firstSample + Database.GetAnimationNumSamples(animationIndex);
+
+		for (int32 largeBegin = firstSample; largeBegin < endSample; largeBegin += LargeSegmentSize)
+		{
+			FSegment largeSegment;
+			largeSegment.BeginSample = largeBegin;
+			largeSegment.EndSample = FMath::Min(largeBegin + LargeSegmentSize, endSample);
+			largeSegment.FirstSmallSegment = SmallSegments.Num();
+
+			for (int32 smallBegin = largeSegment.BeginSample; smallBegin < largeSegment.EndSample; smallBegin += SmallSegmentSize)
+			{
+				FSegment smallSegment;
+				smallSegment.BeginSample = smallBegin;
+				smallSegment.EndSample = FMath::Min(smallBegin + SmallSegmentSize, largeSegment.EndSample);
+
+				SmallSegments.Add(smallSegment);
+				AddSegmentBounds(Database, smallSegment, SmallBounds);
+			}
+
+			largeSegment.EndSmallSegment = SmallSegments.Num();
+			LargeSegments.Add(largeSegment);
+			AddSegmentBounds(Database, largeSegment, LargeBounds);
+		}
+	}
+}
+
+void FMotionFeatureAABBTree::Reset()
+{
+	LargeSegments.Reset();
+	SmallSegments.Reset();
+	LargeBounds.Reset();
+	SmallBounds.Reset();
+}
+
+void FMotionFeatureAABBTree::Serialize(FArchive& Ar)
+{
+	Ar << LargeSegments;
+	Ar << SmallSegments;
+	LargeBounds.BulkSerialize(Ar);
+	SmallBounds.BulkSerialize(Ar);
+}
+
+SIZE_T FMotionFeatureAABBTree::GetAllocatedSize() const
+{
+	return LargeSegments.GetAllocatedSize() + SmallSegments.GetAllocatedSize() + LargeBounds.GetAllocatedSize() + SmallBounds.GetAllocatedSize();
+}
+
+void FMotionFeatureAABBTree::FindLowestCost(EMotionMatchingCostKernel CostKernel, const FMotionFeatureDatabase& Database, const float* Query, const float* Weights, FMotionMatchingSearchResult& InOutResult, FMotionMatchingSearchStats& OutStats) const
+{
+	const int32 numDimensions = Database.GetNumDimensions();
+	const MotionMatchingCostKernel::FActiveDimensions active{Query, Weights, numDimensions};
+
+	// Visiting the most promising segments first lowers the best cost early, so more of the remaining ones get rejected:
+	TArray<TPair<float, int32>, TInlineAllocator<256>> largeSegmentOrder;
+	largeSegmentOrder.Reserve(LargeSegments.Num());
+
+	for (int32 largeIndex = 0; largeIndex < LargeSegments.Num(); ++largeIndex)
+	{
+		const float* largeBounds = LargeBounds.GetData() + 2 * numDimensions * largeIndex;
+		largeSegmentOrder.Emplace(ComputeLowerBound(largeBounds, active, numDimensions), largeIndex);
+	}
+
+	largeSegmentOrder.Sort([](const TPair<float, int32>& Lhs, const TPair<float, int32>& Rhs)
+	{
+		return (Lhs.Key < Rhs.Key) || (Lhs.Key == Rhs.Key && Lhs.Value < Rhs.Value);
+	});
+
+	for (const TPair<float, int32>& largeSegmentEntry : largeSegmentOrder)
+	{
+		const FSegment& largeSegment = LargeSegments[largeSegmentEntry.Value];
+
+		if (largeSegmentEntry.Key > InOutResult.Cost)
+		{
+			OutStats.CandidatesPruned += largeSegment.EndSample - largeSegment.BeginSample;
+
+			continue;
+		}
+
+		for (int32 smallIndex = largeSegment.FirstSmallSegment; smallIndex < largeSegment.EndSmallSegment; ++smallIndex)
+		{
+			const FSegment& smallSegment = SmallSegments[smallIndex];
+			const float* smallBounds = SmallBounds.GetData() + 2 * numDimensions * smallIndex;
+
+			if (ComputeLowerBound(smallBounds, active, numDimensions) > InOutResult.Cost)
+			{
+				OutStats.CandidatesPruned += smallSegment.EndSample - smallSegment.BeginSample;
+
+				continue;
+			}
+
+			MotionMatchingCostKernel::FindLowestCost(CostKernel, Database, active, smallSegment.BeginSample, smallSegment.EndSample, InOutResult);
+			OutStats.CandidatesEvaluated += smallSegment.EndSample - smallSegment.BeginSample;
+		}
+	}
+}
+
+void FMotionFeatureAABBTree::AddSegmentBounds(const FMotionFeatureDatabase& Database, const FSegment& Segment, TArray<float>& OutBounds) const
+{
+	const int32 numDimensions = Database.GetNumDimensions();
+	const int32 boundsOffset = OutBounds.AddUninitialized(2 * numDimensions);
+	float* minimums = OutBounds.GetData() + boundsOffset;
+	float* maximums = minimums + numDimensions;
+
+	for (int32 dimension = 0; dimension < numDimensions; ++dimension)
+	{
+		minimums[dimension] = MAX_flt;
+		maximums[dimension] = -MAX_flt;
+	}
+
+	// Boxes hold the values the kernels scan, otherwise a quantized sample could lie outside its box and its segment
+	// could be rejected although it holds the best match:
+	for (int32 sampleIndex = Segment.BeginSample; sampleIndex < Segment.EndSample; ++sampleIndex)
+	{
+		for (int32 dimension = 0; dimension < numDimensions; ++dimension)
+		{
+			const float feature = Database.GetScannedFeature(sampleIndex, dimension);
+			minimums[dimension] = FMath::Min(minimums[dimension], feature);
+			maximums[dimension] = FMath::Max(maximums[dimension], feature);
+		}
+	}
+}
@@ -0,0 +1,541 @@
+#include "MotionFeatureDatabase.h"
+#include "BoneToRootTransforms.h"
+#include "MotionMatching.h"
+#include "Animation/AnimSequence.h"
+
+namespace
+{
+	// Root motion from AnimTime to AnimTime + TrajectoryTime. Past points are where the root was, clamped to the
+	// start of the clip.
+	FTransform ExtractTrajectoryPoint(const UAnimSequence& AnimSequence, float AnimTime, float TrajectoryTime)
+	{
+		if (TrajectoryTime >= 0.0f)
+		{
+			return AnimSequence.ExtractRootMotion(AnimTime, TrajectoryTime, true);
+		}
+
+		const float pastTime = FMath::Max(AnimTime + TrajectoryTime, 0.0f);
+
+		return AnimSequence.ExtractRootMotion(pastTime, AnimTime - pastTime, false).Inverse();
+	}
+}
+
+void FMotionFeatureDatabase::Build(const TArray<UAnimSequence*>& InAnimationsArray, const USkeleton* InSkeleton, const TArray<FName>& InBoneNames, float InAnimationSampling, const TArray<float>& InTrajectoryTimes, const FMotionMirrorTable& InMirrorTable)
+{
+	Reset();
+
+	if (InAnimationSampling <= 0.0f)
+	{
+		ensureMsgf(false, TEXT("Animation sampling has to be greater than zero"));
+
+		return;
+	}
+
+	AnimationSampling = InAnimationSampling;
+	TrajectoryTimes = InTrajectoryTimes;
+	BoneNames = InBoneNames;
+	NumDimensions = GetBoneVelocitiesOffset() + 3 * GetNumBones();
+
+	// Bone indices are resolved once against the skeleton the animations are authored for:
+	TArray<int32> boneIndices;
+
+	if (InSkeleton)
+	{
+		FBoneToRootTransforms::ResolveBoneIndices(InSkeleton->GetReferenceSkeleton(), BoneNames, boneIndices);
+	}
+	else
+	{
+		boneIndices.Init(INDEX_NONE, BoneNames.Num());
+	}
+
+	for (int32 boneIndex = 0; boneIndex < boneIndices.Num(); ++boneIndex)
+	{
+		if (boneIndices[boneIndex] == INDEX_NONE)
+		{
+			UE_LOG(LogMotionMatching, Warning, TEXT("Bone %s is not part of the skeleton, its features are left at zero"), *BoneNames[boneIndex].ToString());
+		}
+	}
+
+	// Mirrored features need the skeleton to find every bone's counterpart:
+	bHasMirroredAnimations = InMirrorTable.IsEnabled() && InSkeleton;
+
+	for (int32 mirrorPass = 0; mirrorPass < (bHasMirroredAnimations ? 2 : 1); ++mirrorPass)
+	{
+		for (int32 animationIndex = 0; animationIndex < InAnimationsArray.Num(); ++animationIndex)
+		{
+			const int32 firstSample = SampleKeys.Num();
+
+			if (InAnimationsArray[animationIndex])
+			{
+				AddAnimationSamples(animationIndex, InAnimationsArray[animationIndex], boneIndices, (mirrorPass == 1) ? &InMirrorTable : nullptr);
+			}
+
+			AnimationFirstSamples.Add(firstSample);
+			AnimationNumSamples.Add(SampleKeys.Num() - firstSample);
+		}
+	}
+
+	NormalizeRows();
+	BuildBlockedFeatures();
+}
+
+void FMotionFeatureDatabase::BuildFromFeatures(const TArray<float>& InFeatures, const TArray<int32>& InAnimationNumSamples, const TArray<FName>& InBoneNames, float InAnimationSampling, const TArray<float>& InTrajectoryTimes)
+{
+	Reset();
+
+	AnimationSampling = InAnimationSampling;
+	TrajectoryTimes = InTrajectoryTimes;
+	BoneNames = InBoneNames;
+	NumDimensions = GetBoneVelocitiesOffset() + 3 * GetNumBones();
+
+	int32 numSamples = 0;
+
+	for (const int32 animationNumSamples : InAnimationNumSamples)
+	{
+		numSamples += animationNumSamples;
+	}
+
+	if (AnimationSampling <= 0.0f || InFeatures.Num() != numSamples * NumDimensions)
+	{
+		ensureMsgf(false, TEXT("Raw features do not match the animations' samples"));
+		Reset();
+
+		return;
+	}
+
+	Features = InFeatures;
+
+	for (int32 animationIndex = 0; animationIndex < InAnimationNumSamples.Num(); ++animationIndex)
+	{
+		AnimationFirstSamples.Add(SampleKeys.Num());
+		AnimationNumSamples.Add(InAnimationNumSamples[animationIndex]);
+
+		for (int32 keyIndex = 0; keyIndex < InAnimationNumSamples[animationIndex]; ++keyIndex)
+		{
+			SampleKeys.Add(FAnimKey{animationIndex, keyIndex * AnimationSampling});
+		}
+	}
+
+	NormalizeRows();
+	BuildBlockedFeatures();
+}
+
+void FMotionFeatureDatabase::GenerateSyntheticFeatures(int32 InNumSamples, int32 InNumAnimations, int32 InNumBones, float InAnimationSampling, const TArray<float>& InTrajectoryTimes, int32 InSeed, TArray<float>& OutFeatures, TArray<int32>& OutAnimationNumSamples)
+{
+	FRandomStream randomStream{InSeed};
+	const int32 numDimensions = 5 * InTrajectoryTimes.Num() + 6 * InNumBones;
+	const int32 numAnimations = FMath::Clamp(InNumAnimations, 1, FMath::Max(InNumSamples, 1));
+
+	OutFeatures.Reset(InNumSamples * numDimensions);
+	OutAnimationNumSamples.Reset();
+
+	for (int32 animationIndex = 0; animationIndex < numAnimations; ++animationIndex)
+	{
+		const int32 numSamples = InNumSamples / numAnimations + (animationIndex < InNumSamples % numAnimations ? 1 : 0);
+		const float speed = randomStream.FRandRange(0.0f, 600.0f);
+		const float turnRate = randomStream.FRandRange(-2.0f, 2.0f);
+		const float stepRate = randomStream.FRandRange(4.0f, 12.0f);
+		OutAnimationNumSamples.Add(numSamples);
+
+		for (int32 keyIndex = 0; keyIndex < numSamples; ++keyIndex)
+		{
+			const float time = keyIndex * InAnimationSampling;
+			// Speed and turning drift slowly along the clip:
+			const float currentSpeed = speed * (1.0f + 0.25f * FMath::Sin(0.5f * time));
+			const float currentTurnRate = turnRate * FMath::Cos(0.3f * time);
+
+			for (const float trajectoryTime : InTrajectoryTimes)
+			{
+				const float yaw = currentTurnRate * trajectoryTime;
+				OutFeatures.Add(currentSpeed * trajectoryTime * FMath::Cos(0.5f * yaw));
+				OutFeatures.Add(currentSpeed * trajectoryTime * FMath::Sin(0.5f * yaw));
+				OutFeatures.Add(0.0f);
+			}
+
+			for (const float trajectoryTime : InTrajectoryTimes)
+			{
+				OutFeatures.Add(FMath::Cos(currentTurnRate * trajectoryTime));
+				OutFeatures.Add(FMath::Sin(currentTurnRate * trajectoryTime));
+			}
+
+			const float phase = stepRate * time;
+
+			for (int32 boneIndex = 0; boneIndex < InNumBones; ++boneIndex)
+			{
+				const float bonePhase = phase + boneIndex * PI / 3.0f;
+				OutFeatures.Add(20.0f * boneIndex + 0.05f * currentSpeed * FMath::Sin(bonePhase));
+				OutFeatures.Add((boneIndex % 2 == 0 ? 15.0f : -15.0f) + 2.0f * FMath::Cos(bonePhase));
+				OutFeatures.Add(10.0f * boneIndex + 5.0f * FMath::Abs(FMath::Sin(bonePhase)));
+			}
+
+			for (int32 boneIndex = 0; boneIndex < InNumBones; ++boneIndex)
+			{
+				const float bonePhase = phase + boneIndex * PI / 3.0f;
+				OutFeatures.Add(0.05f * currentSpeed * stepRate * FMath::Cos(bonePhase));
+				OutFeatures.Add(-2.0f * stepRate * FMath::Sin(bonePhase));
+				OutFeatures.Add(5.0f * stepRate * FMath::Cos(bonePhase) * FMath::Sign(FMath::Sin(bonePhase)));
+			}
+		}
+	}
+}
+
+void FMotionFeatureDatabase::Quantize(EMotionFeatureQuantization InQuantization)
+{
+	if (InQuantization == EMotionFeatureQuantization::None || Quantization != EMotionFeatureQuantization::None)
+	{
+		return;
+	}
+
+	const bool bIsInt16 = (InQuantization == EMotionFeatureQuantization::Int16);
+	const int32 valueSize = bIsInt16 ? sizeof(int16) : sizeof(int8);
+	const float maxValue = bIsInt16 ? MAX_int16 : MAX_int8;
+
+	// Every dimension's range is centered on zero and spread over the whole integer range:
+	QuantizationScales.Init(0.0f, NumDimensions);
+	QuantizationOffsets.Init(0.0f, NumDimensions);
+
+	for (int32 dimension = 0; dimension < NumDimensions; ++dimension)
+	{
+		float minimum = MAX_flt;
+		float maximum = -MAX_flt;
+
+		for (int32 sampleIndex = 0; sampleIndex < GetNumSamples(); ++sampleIndex)
+		{
+			minimum = FMath::Min(minimum, GetFeatures(sampleIndex)[dimension]);
+			maximum = FMath::Max(maximum, GetFeatures(sampleIndex)[dimension]);
+		}
+
+		if (minimum <= maximum)
+		{
+			QuantizationScales[dimension] = (maximum - minimum) * 0.5f / maxValue;
+			QuantizationOffsets[dimension] = (maximum + minimum) * 0.5f;
+		}
+	}
+
+	QuantizedFeatures.Reset();
+	QuantizedFeatures.AddZeroed(GetNumBlocks() * NumDimensions * BlockWidth * valueSize);
+	QuantizationError = 0.0f;
+
+	for (int32 sampleIndex = 0; sampleIndex < GetNumSamples(); ++sampleIndex)
+	{
+		const float* row = GetFeatures(sampleIndex);
+		const int32 valueOffset = (sampleIndex / BlockWidth) * NumDimensions * BlockWidth + sampleIndex % BlockWidth;
+
+		for (int32 dimension = 0; dimension < NumDimensions; ++dimension)
+		{
+			const float scale = QuantizationScales[dimension];
+			const int32 value = (scale > 0.0f) ? FMath::Clamp(FMath::RoundToInt((row[dimension] - QuantizationOffsets[dimension]) / scale), -static_cast<int32>(maxValue), static_cast<int32>(maxValue)) : 0;
+			const int32 valueIndex = valueOffset + dimension * BlockWidth;
+
+			if (bIsInt16)
+			{
+				reinterpret_cast<int16*>(QuantizedFeatures.GetData())[valueIndex] = static_cast<int16>(value);
+			}
+			else
+			{
+				reinterpret_cast<int8*>(QuantizedFeatures.GetData())[valueIndex] = static_cast<int8>(value);
+			}
+
+			// Dequantized the way the kernels do it:
+			float dequantized = static_cast<float>(value) * scale;
+			dequantized = dequantized + QuantizationOffsets[dimension];
+			QuantizationError = FMath::Max(QuantizationError, FMath::Abs(dequantized - row[dimension]));
+		}
+	}
+
+	// The float blocks are what the quantized ones replace:
+	BlockedFeatures.Empty();
+	Quantization = InQuantization;
+
+	UE_LOG(LogMotionMatching, Log, TEXT("Quantized %d motion samples to %d bits, largest feature error %g standard deviations"), GetNumSamples(), 8 * valueSize, QuantizationError);
+}
+
+float FMotionFeatureDatabase::GetScannedFeature(int32 SampleIndex, int32 Dimension) const
+{
+	if (Quantization == EMotionFeatureQuantization::None)
+	{
+		return GetFeatures(SampleIndex)[Dimension];
+	}
+
+	const int32 valueIndex = (SampleIndex / BlockWidth) * NumDimensions * BlockWidth + Dimension * BlockWidth + SampleIndex % BlockWidth;
+	const int32 value = (Quantization == EMotionFeatureQuantization::Int16)
+		? reinterpret_cast<const int16*>(QuantizedFeatures.GetData())[valueIndex]
+		: reinterpret_cast<const int8*>(QuantizedFeatures.GetData())[valueIndex];
+
+	// Dequantized the way the kernels do it:
+	float dequantized = static_cast<float>(value) * QuantizationScales[Dimension];
+	dequantized = dequantized + QuantizationOffsets[Dimension];
+
+	return dequantized;
+}
+
+void FMotionFeatureDatabase::Reset()
+{
+	Features.Reset();
+	FeatureMeans.Reset();
+	FeatureDeviations.Reset();
+	BlockedFeatures.Reset();
+	QuantizedFeatures.Reset();
+	QuantizationScales.Reset();
+	QuantizationOffsets.Reset();
+	QuantizationError = 0.0f;
+	Quantization = EMotionFeatureQuantization::None;
+	SampleKeys.Reset();
+	AnimationFirstSamples.Reset();
+	AnimationNumSamples.Reset();
+	TrajectoryTimes.Reset();
+	BoneNames.Reset();
+	AnimationSampling = 0.0f;
+	NumDimensions = 0;
+	bHasMirroredAnimations = false;
+}
+
+void FMotionFeatureDatabase::Serialize(FArchive& Ar)
+{
+	Features.BulkSerialize(Ar);
+	FeatureMeans.BulkSerialize(Ar);
+	FeatureDeviations.BulkSerialize(Ar);
+	BlockedFeatures.BulkSerialize(Ar);
+	QuantizedFeatures.BulkSerialize(Ar);
+	QuantizationScales.BulkSerialize(Ar);
+	QuantizationOffsets.BulkSerialize(Ar);
+	Ar << QuantizationError;
+	Ar << Quantization;
+	Ar << SampleKeys;
+	AnimationFirstSamples.BulkSerialize(Ar);
+	AnimationNumSamples.BulkSerialize(Ar);
+	TrajectoryTimes.BulkSerialize(Ar);
+	Ar << BoneNames;
+	Ar << AnimationSampling;
+	Ar << NumDimensions;
+	Ar << bHasMirroredAnimations;
+}
+
+SIZE_T FMotionFeatureDatabase::GetAllocatedSize() const
+{
+	return Features.GetAllocatedSize() + FeatureMeans.GetAllocatedSize() + FeatureDeviations.GetAllocatedSize()
+		+ BlockedFeatures.GetAllocatedSize() + QuantizedFeatures.GetAllocatedSize() + QuantizationScales.GetAllocatedSize()
+		+ QuantizationOffsets.GetAllocatedSize() + SampleKeys.GetAllocatedSize() + AnimationFirstSamples.GetAllocatedSize()
+		+ AnimationNumSamples.GetAllocatedSize() + TrajectoryTimes.GetAllocatedSize() + BoneNames.GetAllocatedSize();
+}
+
+int32 FMotionFeatureDatabase::FindSampleIndex(const FAnimKey& AnimKey) const
+{
+	const int32 animationIndex = GetAnimationIndex(AnimKey);
+
+	if (!AnimationNumSamples.IsValidIndex(animationIndex) || AnimationNumSamples[animationIndex] == 0)
+	{
+		return INDEX_NONE;
+	}
+
+	const int32 keyIndex = FMath::Clamp(static_cast<int32>(AnimKey.StartTime / AnimationSampling), 0, AnimationNumSamples[animationIndex] - 1);
+
+	return AnimationFirstSamples[animationIndex] + keyIndex;
+}
+
+int32 FMotionFeatureDatabase::GetAnimationIndex(const FAnimKey& AnimKey) const
+{
+	if (!AnimKey.bMirrored)
+	{
+		return AnimKey.Index;
+	}
+
+	return bHasMirroredAnimations ? GetNumAnimations() / 2 + AnimKey.Index : INDEX_NONE;
+}
+
+void FMotionFeatureDatabase::ExpandWeights(const FMotionFeatureWeights& InWeights, TArray<float>& OutWeights) const
+{
+	OutWeights.Reset();
+	OutWeights.SetNumZeroed(NumDimensions);
+
+	for (int32 dimension = 0; dimension < 3 * GetNumTrajectoryPoints(); ++dimension)
+	{
+		OutWeights[GetTrajectoryPositionsOffset() + dimension] = FMath::Max(InWeights.TrajectoryPositions, 0.0f);
+	}
+
+	for (int32 dimension = 0; dimension < 2 * GetNumTrajectoryPoints(); ++dimension)
+	{
+		OutWeights[GetTrajectoryFacingsOffset() + dimension] = FMath::Max(InWeights.TrajectoryFacings, 0.0f);
+	}
+
+	for (int32 dimension = 0; dimension < 3 * GetNumBones(); ++dimension)
+	{
+		OutWeights[GetBonePositionsOffset() + dimension] = FMath::Max(InWeights.BonePositions, 0.0f);
+		OutWeights[GetBoneVelocitiesOffset() + dimension] = FMath::Max(InWeights.BoneVelocities, 0.0f);
+	}
+}
+
+void FMotionFeatureDatabase::NormalizeFeatures(float* InOutFeatures, int32 FirstDimension, int32 NumFeatureDimensions) const
+{
+	for (int32 dimension = FirstDimension; dimension < FirstDimension + NumFeatureDimensions; ++dimension)
+	{
+		InOutFeatures[dimension] = (InOutFeatures[dimension] - FeatureMeans[dimension]) / FeatureDeviations[dimension];
+	}
+}
+
+void FMotionFeatureDatabase::DenormalizeFeatures(float* InOutFeatures, int32 FirstDimension, int32 NumFeatureDimensions) const
+{
+	for (int32 dimension = FirstDimension; dimension < FirstDimension + NumFeatureDimensions; ++dimension)
+	{
+		InOutFeatures[dimension] = InOutFeatures[dimension] * FeatureDeviations[dimension] + FeatureMeans[dimension];
+	}
+}
+
+void FMotionFeatureDatabase::AddAnimationSamples(int32 AnimationIndex, UAnimSequence* InAnimSequence, const TArray<int32>& BoneIndices, const FMotionMirrorTable* MirrorTable)
+{
+	// A mirrored bone takes the mirrored features of its counterpart:
+	TArray<int32> sourceBoneIndices{BoneIndices};
+
+	if (MirrorTable)
+	{
+		for (int32& boneIndex : sourceBoneIndices)
+		{
+			boneIndex = (boneIndex != INDEX_NONE) ? MirrorTable->GetMirroredBoneIndex(boneIndex) : INDEX_NONE;
+		}
+	}
+
+	const auto mirrorVector = [MirrorTable](const FVector& Vector)
+	{
+		return MirrorTable ? MirrorTable->MirrorVector(Vector) : Vector;
+	};
+
+	const FBoneToRootTransforms boneToRootTransforms{InAnimSequence, sourceBoneIndices, AnimationSampling, true};
+	const int32 facingsOffset = GetTrajectoryFacingsOffset();
+	const int32 bonePositionsOffset = GetBonePositionsOffset();
+	const int32 boneVelocitiesOffset = GetBoneVelocitiesOffset();
+
+	for (int32 keyIndex = 0; keyIndex < boneToRootTransforms.GetNumSamples(); ++keyIndex)
+	{
+		const float animTime = keyIndex * AnimationSampling;
+		SampleKeys.Add(FAnimKey{AnimationIndex, animTime, MirrorTable != nullptr});
+		const int32 rowOffset = Features.AddZeroed(NumDimensions);
+		float* row = Features.GetData() + rowOffset;
+
+		for (int32 pointIndex = 0; pointIndex < TrajectoryTimes.Num(); ++pointIndex)
+		{
+			FTransform rootMotion = ExtractTrajectoryPoint(*InAnimSequence, animTime, TrajectoryTimes[pointIndex]);
+
+			if (MirrorTable)
+			{
+				rootMotion = MirrorTable->MirrorTransform(rootMotion);
+			}
+
+			const FVector& translation = rootMotion.GetTranslation();
+			const FVector& facing = rootMotion.GetRotation().GetForwardVector();
+
+			row[3 * pointIndex + 0] = translation.X;
+			row[3 * pointIndex + 1] = translation.Y;
+			row[3 * pointIndex + 2] = translation.Z;
+			row[facingsOffset + 2 * pointIndex + 0] = facing.X;
+			row[facingsOffset + 2 * pointIndex + 1] = facing.Y;
+		}
+
+		const FVector* bonePositions = boneToRootTransforms.GetSampleTranslations(keyIndex);
+		const FVector* boneVelocities = boneToRootTransforms.GetSampleVelocities(keyIndex);
+
+		for (int32 boneIndex = 0; boneIndex < BoneIndices.Num(); ++boneIndex)
+		{
+			const FVector& bonePosition = mirrorVector(bonePositions[boneIndex]);
+			const FVector& boneVelocity = mirrorVector(boneVelocities[boneIndex]);
+
+			row[bonePositionsOffset + 3 * boneIndex + 0] = bonePosition.X;
+			row[bonePositionsOffset + 3 * boneIndex + 1] = bonePosition.Y;
+			row[bonePositionsOffset + 3 * boneIndex + 2] = bonePosition.Z;
+			row[boneVelocitiesOffset + 3 * boneIndex + 0] = boneVelocity.X;
+			row[boneVelocitiesOffset + 3 * boneIndex + 1] = boneVelocity.Y;
+			row[boneVelocitiesOffset + 3 * boneIndex + 2] = boneVelocity.Z;
+		}
+	}
+}
+
+void FMotionFeatureDatabase::NormalizeRows()
+{
+	const int32 numSamples = GetNumSamples();
+	FeatureMeans.Init(0.0f, NumDimensions);
+	FeatureDeviations.Init(1.0f, NumDimensions);
+
+	if (numSamples == 0)
+	{
+		return;
+	}
+
+	TArray<double> sums;
+	sums.SetNumZeroed(NumDimensions);
+
+	for (int32 sampleIndex = 0; sampleIndex < numSamples; ++sampleIndex)
+	{
+		const float* row = GetFeatures(sampleIndex);
+
+		for (int32 dimension = 0; dimension < NumDimensions; ++dimension)
+		{
+			sums[dimension] += row[dimension];
+		}
+	}
+
+	for (int32 dimension = 0; dimension < NumDimensions; ++dimension)
+	{
+		FeatureMeans[dimension] = sums[dimension] / numSamples;
+		sums[dimension] = 0.0;
+	}
+
+	for (int32 sampleIndex = 0; sampleIndex < numSamples; ++sampleIndex)
+	{
+		const float* row = GetFeatures(sampleIndex);
+
+		for (int32 dimension = 0; dimension < NumDimensions; ++dimension)
+		{
+			sums[dimension] += FMath::Square(row[dimension] - FeatureMeans[dimension]);
+		}
+	}
+
+	// Every dimension of a channel shares one deviation, so that distances within the channel keep their proportions:
+	const int32 channelOffsets[] = {GetTrajectoryPositionsOffset(), GetTrajectoryFacingsOffset(), GetBonePositionsOffset(), GetBoneVelocitiesOffset(), NumDimensions};
+
+	for (int32 channelIndex = 0; channelIndex + 1 < UE_ARRAY_COUNT(channelOffsets); ++channelIndex)
+	{
+		const int32 channelBegin = channelOffsets[channelIndex];
+		const int32 channelEnd = channelOffsets[channelIndex + 1];
+		double channelVariance = 0.0;
+
+		if (channelEnd == channelBegin)
+		{
+			continue;
+		}
+
+		for (int32 dimension = channelBegin; dimension < channelEnd; ++dimension)
+		{
+			channelVariance += sums[dimension];
+		}
+
+		const float channelDeviation = FMath::Sqrt(channelVariance / (static_cast<double>(channelEnd - channelBegin) * numSamples));
+
+		// Constant channels are only centered:
+		for (int32 dimension = channelBegin; dimension < channelEnd; ++dimension)
+		{
+			FeatureDeviations[dimension] = (channelDeviation > KINDA_SMALL_NUMBER) ? channelDeviation : 1.0f;
+		}
+	}
+
+	for (int32 sampleIndex = 0; sampleIndex < numSamples; ++sampleIndex)
+	{
+		NormalizeFeatures(Features.GetData() + sampleIndex * NumDimensions, 0, NumDimensions);
+	}
+}
+
+void FMotionFeatureDatabase::BuildBlockedFeatures()
+{
+	BlockedFeatures.Reset();
+	BlockedFeatures.AddZeroed(GetNumBlocks() * NumDimensions * BlockWidth);
+
+	for (int32 sampleIndex = 0; sampleIndex < GetNumSamples(); ++sampleIndex)
+	{
+		const float* row = GetFeatures(sampleIndex);
+		float* block = BlockedFeatures.GetData() + (sampleIndex / BlockWidth) * NumDimensions * BlockWidth;
+		const int32 lane = sampleIndex % BlockWidth;
+
+		for (int32 dimension = 0; dimension < NumDimensions; ++dimension)
+		{
+			block[dimension * BlockWidth + lane] = row[dimension];
+		}
+	}
+}
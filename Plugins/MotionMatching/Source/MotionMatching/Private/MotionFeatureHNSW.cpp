@@ -0,0 +1,414 @@
+#include "MotionFeatureHNSW.h"
+#include "MotionFeatureDatabase.h"
+#include "Misc/MemStack.h"
+
+namespace
+{
+	typedef TPair<float, int32> FCandidate;
+
+	bool IsCloser(const FCandidate& Lhs, const FCandidate& Rhs)
+	{
+		return (Lhs.Key < Rhs.Key) || (Lhs.Key == Rhs.Key && Lhs.Value < Rhs.Value);
+	}
+
+	struct FCloserFirst
+	{
+		bool operator()(const FCandidate& Lhs, const FCandidate& Rhs) const { return IsCloser(Lhs, Rhs); }
+	};
+
+	struct FFartherFirst
+	{
+		bool operator()(const FCandidate& Lhs, const FCandidate& Rhs) const { return IsCloser(Rhs, Lhs); }
+	};
+
+	float ComputeSampleCost(const FMotionFeatureDatabase& Database, const float* Query, const float* Weights, int32 SampleIndex)
+	{
+		return MotionMatchingCostKernel::ComputeCost(Database.GetFeatures(SampleIndex), Query, Weights, Database.GetNumDimensions());
+	}
+}
+
+void FMotionFeatureHNSW::Build(const FMotionFeatureDatabase& Database, const float* Weights)
+{
+	Reset();
+
+	const int32 numSamples = Database.GetNumSamples();
+
+	if (numSamples == 0)
+	{
+		return;
+	}
+
+	// Levels follow the usual geometric distribution with a 1 / MaxLinks chance of reaching the next layer:
+	const float levelMultiplier = 1.0f / FMath::Loge(static_cast<float>(MaxLinks));
+	FRandomStream randomStream{RandomSeed};
+
+	for (int32 sampleIndex = 0; sampleIndex < numSamples; ++sampleIndex)
+	{
+		const float random = FMath::Max(1.0f - randomStream.FRand(), SMALL_NUMBER);
+		const int32 level = FMath::Min(FMath::FloorToInt(-FMath::Loge(random) * levelMultiplier), MaxLayers - 1);
+
+		Levels.Add(static_cast<uint8>(level));
+		LinkOffsets.Add(Links.Num());
+		CountOffsets.Add(LinkCounts.Num());
+		Links.AddUninitialized(MaxLinksLayer0 + level * MaxLinks);
+		LinkCounts.AddZeroed(level + 1);
+	}
+
+	FMemMark mark{FMemStack::Get()};
+	FVisitedSamples visited{ConstructionBudget * MaxLinks};
+	TArray<FCandidate> nearest;
+	TArray<int32> neighbors;
+	TArray<FCandidate> neighborCandidates;
+
+	for (int32 sampleIndex = 0; sampleIndex < numSamples; ++sampleIndex)
+	{
+		const int32 level = Levels[sampleIndex];
+
+		if (EntryPoint == INDEX_NONE)
+		{
+			EntryPoint = sampleIndex;
+			TopLayer = level;
+
+			continue;
+		}
+
+		const float* features = Database.GetFeatures(sampleIndex);
+		int32 evaluated = 0;
+		FCandidate entry{ComputeSampleCost(Database, features, Weights, EntryPoint), EntryPoint};
+		DescendToLayer(Database, features, Weights, level, entry, evaluated);
+
+		nearest.Reset();
+		nearest.Add(entry);
+
+		for (int32 layer = FMath::Min(level, TopLayer); layer >= 0; --layer)
+		{
+			visited.StartWalk();
+
+			for (const FCandidate& candidate : nearest)
+			{
+				visited.Visit(candidate.Value);
+			}
+
+			SearchLayer(Database, features, Weights, layer, ConstructionBudget, nearest, visited, evaluated);
+
+			neighborCandidates = nearest;
+			SelectNeighbors(Database, Weights, neighborCandidates, GetMaxLinks(layer), neighbors);
+			SetLinks(sampleIndex, layer, neighbors);
+
+			// Link back from every neighbour, re-selecting its neighbours when it is already full:
+			for (const int32 neighbor : neighbors)
+			{
+				const int32 numLinks = GetNumLinks(neighbor, layer);
+
+				if (numLinks < GetMaxLinks(layer))
+				{
+					Links[GetLinksOffset(neighbor, layer) + numLinks] = sampleIndex;
+					LinkCounts[CountOffsets[neighbor] + layer] += 1;
+
+					continue;
+				}
+
+				const float* neighborFeatures = Database.GetFeatures(neighbor);
+				const int32* neighborLinks = GetLinks(neighbor, layer);
+
+				neighborCandidates.Reset();
+				neighborCandidates.Emplace(ComputeSampleCost(Database, neighborFeatures, Weights, sampleIndex), sampleIndex);
+				for (int32 linkIndex = 0; linkIndex < numLinks; ++linkIndex)
+				{
+					neighborCandidates.Emplace(ComputeSampleCost(Database, neighborFeatures, Weights, neighborLinks[linkIndex]), neighborLinks[linkIndex]);
+				}
+
+				TArray<int32> neighborNeighbors;
+				SelectNeighbors(Database, Weights, neighborCandidates, GetMaxLinks(layer), neighborNeighbors);
+				SetLinks(neighbor, layer, neighborNeighbors);
+			}
+		}
+
+		if (level > TopLayer)
+		{
+			TopLayer = level;
+			EntryPoint = sampleIndex;
+		}
+	}
+}
+
+void FMotionFeatureHNSW::Reset()
+{
+	Links.Reset();
+	LinkOffsets.Reset();
+	LinkCounts.Reset();
+	CountOffsets.Reset();
+	Levels.Reset();
+	EntryPoint = INDEX_NONE;
+	TopLayer = 0;
+}
+
+void FMotionFeatureHNSW::Serialize(FArchive& Ar)
+{
+	Links.BulkSerialize(Ar);
+	LinkOffsets.BulkSerialize(Ar);
+	LinkCounts.BulkSerialize(Ar);
+	CountOffsets.BulkSerialize(Ar);
+	Levels.BulkSerialize(Ar);
+	Ar << EntryPoint;
+	Ar << TopLayer;
+}
+
+SIZE_T FMotionFeatureHNSW::GetAllocatedSize() const
+{
+	return Links.GetAllocatedSize() + LinkOffsets.GetAllocatedSize() + LinkCounts.GetAllocatedSize() + CountOffsets.GetAllocatedSize() + Levels.GetAllocatedSize();
+}
+
+void FMotionFeatureHNSW::FindLowestCost(const FMotionFeatureDatabase& Database, const float* Query, const float* Weights, int32 CandidateBudget, FMotionMatchingSearchResult& InOutResult, FMotionMatchingSearchStats& OutStats) const
+{
+	if (!IsBuilt())
+	{
+		return;
+	}
+
+	int32 evaluated = 1;
+	FCandidate entry{ComputeSampleCost(Database, Query, Weights, EntryPoint), EntryPoint};
+	DescendToLayer(Database, Query, Weights, 0, entry, evaluated);
+
+	const int32 candidateBudget = FMath::Max(CandidateBudget, 1);
+	FMemMark mark{FMemStack::Get()};
+	FVisitedSamples visited{candidateBudget * MaxLinks};
+	visited.Visit(entry.Value);
+
+	TArray<FCandidate> nearest;
+	nearest.Add(entry);
+	SearchLayer(Database, Query, Weights, 0, candidateBudget, nearest, visited, evaluated);
+
+	for (const FCandidate& candidate : nearest)
+	{
+		if (candidate.Key < InOutResult.Cost || (candidate.Key == InOutResult.Cost && candidate.Value < InOutResult.SampleIndex))
+		{
+			InOutResult.Cost = candidate.Key;
+			InOutResult.SampleIndex = candidate.Value;
+		}
+	}
+
+	OutStats.CandidatesEvaluated += evaluated;
+	OutStats.CandidatesPruned += Database.GetNumSamples() - evaluated;
+}
+
+float FMotionFeatureHNSW::MeasureRecall(const FMotionFeatureDatabase& Database, const float* Weights, int32 CandidateBudget, int32 NumQueries) const
+{
+	const int32 numSamples = Database.GetNumSamples();
+
+	if (!IsBuilt() || NumQueries <= 0)
+	{
+		return 0.0f;
+	}
+
+	// Queries sit between two random samples so that they rarely coincide with a database row:
+	FRandomStream randomStream{RandomSeed};
+	TArray<float> query;
+	query.SetNumUninitialized(Database.GetNumDimensions());
+	int32 numMatches = 0;
+
+	for (int32 queryIndex = 0; queryIndex < NumQueries; ++queryIndex)
+	{
+		const float* first = Database.GetFeatures(randomStream.RandRange(0, numSamples - 1));
+		const float* second = Database.GetFeatures(randomStream.RandRange(0, numSamples - 1));
+
+		for (int32 dimension = 0; dimension < query.Num(); ++dimension)
+		{
+			query[dimension] = first[dimension] + 0.25f * (second[dimension] - first[dimension]);
+		}
+
+		FMotionMatchingSearchStats stats;
+		FMotionMatchingSearchResult exactResult;
+		FMotionMatchingSearchResult approximateResult;
+		MotionMatchingCostKernel::FindLowestCost(EMotionMatchingCostKernel::Auto, Database, query.GetData(), Weights, 0, numSamples, exactResult);
+		FindLowestCost(Database, query.GetData(), Weights, CandidateBudget, approximateResult, stats);
+
+		numMatches += (exactResult.SampleIndex == approximateResult.SampleIndex) ? 1 : 0;
+	}
+
+	return static_cast<float>(numMatches) / NumQueries;
+}
+
+void FMotionFeatureHNSW::DescendToLayer(const FMotionFeatureDatabase& Database, const float* Query, const float* Weights, int32 TargetLayer, FCandidate& InOutNearest, int32& InOutEvaluated) const
+{
+	for (int32 layer = TopLayer; layer > TargetLayer; --layer)
+	{
+		bool bMoved = true;
+
+		while (bMoved)
+		{
+			bMoved = false;
+			const int32* links = GetLinks(InOutNearest.Value, layer);
+			const int32 numLinks = GetNumLinks(InOutNearest.Value, layer);
+
+			for (int32 linkIndex = 0; linkIndex < numLinks; ++linkIndex)
+			{
+				const FCandidate candidate{ComputeSampleCost(Database, Query, Weights, links[linkIndex]), links[linkIndex]};
+				++InOutEvaluated;
+
+				if (IsCloser(candidate, InOutNearest))
+				{
+					InOutNearest = candidate;
+					bMoved = true;
+				}
+			}
+		}
+	}
+}
+
+void FMotionFeatureHNSW::SearchLayer(const FMotionFeatureDatabase& Database, const float* Query, const float* Weights, int32 Layer, int32 CandidateBudget, TArray<FCandidate>& InOutNearest, FVisitedSamples& Visited, int32& InOutEvaluated) const
+{
+	TArray<FCandidate> candidates = InOutNearest;
+	candidates.Heapify(FCloserFirst{});
+	InOutNearest.Heapify(FFartherFirst{});
+
+	while (candidates.Num() > 0)
+	{
+		FCandidate closest;
+		candidates.HeapPop(closest, FCloserFirst{}, false);
+
+		if (InOutNearest.Num() >= CandidateBudget && IsCloser(InOutNearest.HeapTop(), closest))
+		{
+			break;
+		}
+
+		const int32* links = GetLinks(closest.Value, Layer);
+		const int32 numLinks = GetNumLinks(closest.Value, Layer);
+
+		for (int32 linkIndex = 0; linkIndex < numLinks; ++linkIndex)
+		{
+			const int32 link = links[linkIndex];
+
+			if (!Visited.Visit(link))
+			{
+				continue;
+			}
+
+			const FCandidate candidate{ComputeSampleCost(Database, Query, Weights, link), link};
+			++InOutEvaluated;
+
+			if (InOutNearest.Num() < CandidateBudget || IsCloser(candidate, InOutNearest.HeapTop()))
+			{
+				candidates.HeapPush(candidate, FCloserFirst{});
+				InOutNearest.HeapPush(candidate, FFartherFirst{});
+
+				if (InOutNearest.Num() > CandidateBudget)
+				{
+					InOutNearest.HeapPopDiscard(FFartherFirst{}, false);
+				}
+			}
+		}
+	}
+}
+
+FMotionFeatureHNSW::FVisitedSamples::FVisitedSamples(int32 ExpectedVisits)
+{
+	Allocate(FMath::RoundUpToPowerOfTwo(FMath::Max(2 * ExpectedVisits, 64)));
+}
+
+void FMotionFeatureHNSW::FVisitedSamples::StartWalk()
+{
+	FMemory::Memset(Slots, 0xFF, NumSlots * sizeof(int32));
+	NumVisited = 0;
+}
+
+bool FMotionFeatureHNSW::FVisitedSamples::Visit(int32 SampleIndex)
+{
+	// At most half of the slots are used, which keeps the probe sequences short:
+	if (2 * (NumVisited + 1) > NumSlots)
+	{
+		Grow();
+	}
+
+	const uint32 slotMask = NumSlots - 1;
+
+	for (uint32 slot = (static_cast<uint32>(SampleIndex) * 2654435761u) & slotMask; ; slot = (slot + 1) & slotMask)
+	{
+		if (Slots[slot] == SampleIndex)
+		{
+			return false;
+		}
+
+		if (Slots[slot] == INDEX_NONE)
+		{
+			Slots[slot] = SampleIndex;
+			++NumVisited;
+
+			return true;
+		}
+	}
+}
+
+void FMotionFeatureHNSW::FVisitedSamples::Allocate(int32 InNumSlots)
+{
+	Slots = reinterpret_cast<int32*>(FMemStack::Get().PushBytes(InNumSlots * sizeof(int32), alignof(int32)));
+	NumSlots = InNumSlots;
+	StartWalk();
+}
+
+void FMotionFeatureHNSW::FVisitedSamples::Grow()
+{
+	// The old slots stay on the mem stack until the mark is popped:
+	const int32* oldSlots = Slots;
+	const int32 oldNumSlots = NumSlots;
+	Allocate(2 * NumSlots);
+
+	for (int32 slot = 0; slot < oldNumSlots; ++slot)
+	{
+		if (oldSlots[slot] != INDEX_NONE)
+		{
+			Visit(oldSlots[slot]);
+		}
+	}
+}
+
+void FMotionFeatureHNSW::SelectNeighbors(const FMotionFeatureDatabase& Database, const float* Weights, TArray<FCandidate>& Candidates, int32 NumNeighbors, TArray<int32>& OutNeighbors) const
+{
+	OutNeighbors.Reset();
+	Candidates.Sort(FCloserFirst{});
+
+	// Keep a candidate only if it is closer to the base sample than to every neighbour kept so far, which spreads the
+	// links in different directions. Skipped candidates fill the remaining slots to keep the graph well connected.
+	TArray<int32, TInlineAllocator<MaxLinksLayer0>> skipped;
+
+	for (const FCandidate& candidate : Candidates)
+	{
+		if (OutNeighbors.Num() >= NumNeighbors)
+		{
+			break;
+		}
+
+		const float* candidateFeatures = Database.GetFeatures(candidate.Value);
+		bool bIsDiverse = true;
+
+		for (const int32 neighbor : OutNeighbors)
+		{
+			if (ComputeSampleCost(Database, candidateFeatures, Weights, neighbor) < candidate.Key)
+			{
+				bIsDiverse = false;
+				break;
+			}
+		}
+
+		if (bIsDiverse)
+		{
+			OutNeighbors.Add(candidate.Value);
+		}
+		else if (skipped.Num() < NumNeighbors)
+		{
+			skipped.Add(candidate.Value);
+		}
+	}
+
+	for (int32 skippedIndex = 0; skippedIndex < skipped.Num() && OutNeighbors.Num() < NumNeighbors; ++skippedIndex)
+	{
+		OutNeighbors.Add(skipped[skippedIndex]);
+	}
+}
+
+void FMotionFeatureHNSW::SetLinks(int32 SampleIndex, int32 Layer, const TArray<int32>& InLinks)
+{
+	const int32 numLinks = FMath::Min(InLinks.Num(), GetMaxLinks(Layer));
+	FMemory::Memcpy(Links.GetData() + GetLinksOffset(SampleIndex, Layer), InLinks.GetData(), numLinks * sizeof(int32));
+	LinkCounts[CountOffsets[SampleIndex] + Layer] = static_cast<uint8>(numLinks);
+}
@@ -0,0 +1,189 @@
+#include "MotionFeatureKDTree.h"
+#include "MotionFeatureDatabase.h"
+
+namespace
+{
+	// The incrementally updated lower bound is computed with different rounding than the candidate costs, so subtrees
+	// are only pruned when their bound is clearly above the best cost. This keeps results identical to brute force.
+	constexpr float BoundTolerance = 1.0e-4f;
+
+	bool IsWithinBound(float LowerBound, float BestCost)
+	{
+		return LowerBound <= BestCost + BestCost * BoundTolerance;
+	}
+}
+
+struct FMotionFeatureKDTree::FSearchContext
+{
+	const FMotionFeatureDatabase& Database;
+	const float* Query;
+	const float* Weights;
+	TArray<float, TInlineAllocator<64>> Offsets;
+	FMotionMatchingSearchResult& Result;
+	int32 CandidatesEvaluated;
+};
+
+void FMotionFeatureKDTree::Build(const FMotionFeatureDatabase& Database, const float* SplitWeights)
+{
+	Reset();
+
+	if (Database.GetNumSamples() == 0)
+	{
+		return;
+	}
+
+	SampleOrder.Reserve(Database.GetNumSamples());
+	for (int32 sampleIndex = 0; sampleIndex < Database.GetNumSamples(); ++sampleIndex)
+	{
+		SampleOrder.Add(sampleIndex);
+	}
+
+	BuildNode(Database, SplitWeights, 0, Database.GetNumSamples());
+}
+
+void FMotionFeatureKDTree::Reset()
+{
+	Nodes.Reset();
+	SampleOrder.Reset();
+}
+
+void FMotionFeatureKDTree::Serialize(FArchive& Ar)
+{
+	Ar << Nodes;
+	SampleOrder.BulkSerialize(Ar);
+}
+
+SIZE_T FMotionFeatureKDTree::GetAllocatedSize() const
+{
+	return Nodes.GetAllocatedSize() + SampleOrder.GetAllocatedSize();
+}
+
+void FMotionFeatureKDTree::FindLowestCost(const FMotionFeatureDatabase& Database, const float* Query, const float* Weights, FMotionMatchingSearchResult& InOutResult, FMotionMatchingSearchStats& OutStats) const
+{
+	if (!IsBuilt())
+	{
+		return;
+	}
+
+	FSearchContext context{Database, Query, Weights, {}, InOutResult, 0};
+	context.Offsets.SetNumZeroed(Database.GetNumDimensions());
+
+	SearchNode(0, 0.0f, context);
+
+	OutStats.CandidatesEvaluated += context.CandidatesEvaluated;
+	OutStats.CandidatesPruned += SampleOrder.Num() - context.CandidatesEvaluated;
+}
+
+int32 FMotionFeatureKDTree::BuildNode(const FMotionFeatureDatabase& Database, const float* SplitWeights, int32 BeginSample, int32 EndSample)
+{
+	const int32 nodeIndex = Nodes.AddDefaulted();
+	Nodes[nodeIndex].BeginSample = BeginSample;
+	Nodes[nodeIndex].EndSample = EndSample;
+
+	const int32 numSamples = EndSample - BeginSample;
+
+	if (numSamples <= LeafSize)
+	{
+		return nodeIndex;
+	}
+
+	int32 splitDimension = INDEX_NONE;
+	float largestSpread = 0.0f;
+
+	for (int32 dimension = 0; dimension < Database.GetNumDimensions(); ++dimension)
+	{
+		if (SplitWeights[dimension] <= 0.0f)
+		{
+			continue;
+		}
+
+		float mean = 0.0f;
+		for (int32 orderIndex = BeginSample; orderIndex < EndSample; ++orderIndex)
+		{
+			mean += Database.GetFeatures(SampleOrder[orderIndex])[dimension];
+		}
+		mean /= numSamples;
+
+		float variance = 0.0f;
+		for (int32 orderIndex = BeginSample; orderIndex < EndSample; ++orderIndex)
+		{
+			variance += FMath::Square(Database.GetFeatures(SampleOrder[orderIndex])[dimension] - mean);
+		}
+
+		const float spread = SplitWeights[dimension] * variance;
+
+		if (spread > largestSpread)
+		{
+			largestSpread = spread;
+			splitDimension = dimension;
+		}
+	}
+
+	if (splitDimension == INDEX_NONE)
+	{
+		return nodeIndex;
+	}
+
+	Sort(SampleOrder.GetData() + BeginSample, numSamples, [&Database, splitDimension](int32 Lhs, int32 Rhs)
+	{
+		const float lhsValue = Database.GetFeatures(Lhs)[splitDimension];
+		const float rhsValue = Database.GetFeatures(Rhs)[splitDimension];
+
+		return (lhsValue < rhsValue) || (lhsValue == rhsValue && Lhs < Rhs);
+	});
+
+	// Left child holds values <= SplitValue, right child holds values >= SplitValue:
+	const int32 middleSample = BeginSample + numSamples / 2;
+	Nodes[nodeIndex].SplitDimension = splitDimension;
+	Nodes[nodeIndex].SplitValue = Database.GetFeatures(SampleOrder[middleSample])[splitDimension];
+
+	BuildNode(Database, SplitWeights, BeginSample, middleSample);
+	const int32 rightChild = BuildNode(Database, SplitWeights, middleSample, EndSample);
+	Nodes[nodeIndex].RightChild = rightChild;
+
+	return nodeIndex;
+}
+
+void FMotionFeatureKDTree::SearchNode(int32 NodeIndex, float LowerBound, FSearchContext& Context) const
+{
+	const FNode& node = Nodes[NodeIndex];
+	FMotionMatchingSearchResult& result = Context.Result;
+
+	if (node.SplitDimension == INDEX_NONE)
+	{
+		const int32 numDimensions = Context.Database.GetNumDimensions();
+		Context.CandidatesEvaluated += node.EndSample - node.BeginSample;
+
+		for (int32 orderIndex = node.BeginSample; orderIndex < node.EndSample; ++orderIndex)
+		{
+			const int32 sampleIndex = SampleOrder[orderIndex];
+			const float cost = MotionMatchingCostKernel::ComputeCost(Context.Database.GetFeatures(sampleIndex), Context.Query, Context.Weights, numDimensions);
+
+			if (cost < result.Cost || (cost == result.Cost && sampleIndex < result.SampleIndex))
+			{
+				result.Cost = cost;
+				result.SampleIndex = sampleIndex;
+			}
+		}
+
+		return;
+	}
+
+	const int32 splitDimension = node.SplitDimension;
+	const float difference = Context.Query[splitDimension] - node.SplitValue;
+	const int32 nearChild = difference < 0.0f ? NodeIndex + 1 : node.RightChild;
+	const int32 farChild = difference < 0.0f ? node.RightChild : NodeIndex + 1;
+
+	SearchNode(nearChild, LowerBound, Context);
+
+	const float weight = Context.Weights[splitDimension];
+	const float previousOffset = Context.Offsets[splitDimension];
+	const float farLowerBound = LowerBound + weight * (difference * difference - previousOffset * previousOffset);
+
+	if (IsWithinBound(farLowerBound, result.Cost))
+	{
+		Context.Offsets[splitDimension] = difference;
+		SearchNode(farChild, farLowerBound, Context);
+		Context.Offsets[splitDimension] = previousOffset;
+	}
+}
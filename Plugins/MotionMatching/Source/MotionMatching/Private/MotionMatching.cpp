@@ -1,18 +1,25 @@
 // Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
 
 #include "MotionMatching.h"
+#include "MotionDatabase.h"
+#include "MotionMatchingCrowd.h"
 
 #define LOCTEXT_NAMESPACE "FMotionMatchingModule"
 
+DEFINE_LOG_CATEGORY(LogMotionMatching);
+
 void FMotionMatchingModule::StartupModule()
 {
 	// This code will execute after your module is loaded into memory; the exact timing is specified in the .uplugin file per-module
+	FMotionMatchingCrowd::Get().Startup();
 }
 
 void FMotionMatchingModule::ShutdownModule()
 {
 	// This function may be called during shutdown to clean up your module.  For modules that support dynamic reloading,
 	// we call this function before unloading the module.
+	FMotionMatchingCrowd::Get().Shutdown();
+	FMotionDatabaseCache::Get().Reset();
 }
 
 #undef LOCTEXT_NAMESPACE
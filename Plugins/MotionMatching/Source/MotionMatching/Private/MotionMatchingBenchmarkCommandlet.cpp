@@ -0,0 +1,539 @@
+#include "MotionMatchingBenchmarkCommandlet.h"
+#include "MotionMatching.h"
+#include "MotionDatabaseAsset.h"
+#include "AnimContainer.h"
+#include "BoneToRootTransforms.h"
+#include "Animation/AnimSequence.h"
+#include "Animation/Skeleton.h"
+#include "BonePose.h"
+#include "Misc/FileHelper.h"
+#include "Misc/MemStack.h"
+#include "Misc/Parse.h"
+
+namespace
+{
+	struct FBenchmarkOptions
+	{
+		int32 NumSamples = 20000;
+		int32 NumAnimations = 40;
+		int32 NumBones = 6;
+		int32 NumQueries = 1000;
+		int32 NumFrames = 1000;
+		int32 CandidateBudget = 32;
+		int32 Seed = 0x4D4D;
+		TArray<float> TrajectoryTimes = TArray<float>{-0.2f, 0.2f, 0.4f, 0.6f};
+		FString DatabasePath;
+		FString CsvPath;
+		// Thresholds failing the run, 0 disables them:
+		float MinAgreement = 0.0f;
+		float MaxP99Microseconds = 0.0f;
+	};
+
+	struct FBenchmarkResult
+	{
+		FString Name;
+		double BuildMilliseconds = 0.0;
+		SIZE_T AllocatedBytes = 0;
+		double NanosecondsPerCandidate = 0.0;
+		double CandidatesPerQuery = 0.0;
+		double P50Microseconds = 0.0;
+		double P99Microseconds = 0.0;
+		float Agreement = 1.0f;
+	};
+
+	double CyclesToMilliseconds(uint64 Cycles)
+	{
+		return FPlatformTime::ToMilliseconds64(Cycles);
+	}
+
+	double GetPercentile(const TArray<double>& SortedValues, float Percentile)
+	{
+		return SortedValues.Num() > 0 ? SortedValues[FMath::Min(static_cast<int32>(Percentile * SortedValues.Num()), SortedValues.Num() - 1)] : 0.0;
+	}
+
+	FName GetSyntheticBoneName(int32 BoneIndex)
+	{
+		return FName{TEXT("SyntheticBone"), BoneIndex};
+	}
+
+	void ParseOptions(const FString& Params, FBenchmarkOptions& OutOptions)
+	{
+		FParse::Value(*Params, TEXT("Samples="), OutOptions.NumSamples);
+		FParse::Value(*Params, TEXT("Animations="), OutOptions.NumAnimations);
+		FParse::Value(*Params, TEXT("Bones="), OutOptions.NumBones);
+		FParse::Value(*Params, TEXT("Queries="), OutOptions.NumQueries);
+		FParse::Value(*Params, TEXT("Frames="), OutOptions.NumFrames);
+		FParse::Value(*Params, TEXT("Budget="), OutOptions.CandidateBudget);
+		FParse::Value(*Params, TEXT("Seed="), OutOptions.Seed);
+		FParse::Value(*Params, TEXT("Database="), OutOptions.DatabasePath);
+		FParse::Value(*Params, TEXT("Csv="), OutOptions.CsvPath);
+		FParse::Value(*Params, TEXT("MinAgreement="), OutOptions.MinAgreement);
+		FParse::Value(*Params, TEXT("MaxP99="), OutOptions.MaxP99Microseconds);
+
+		FString trajectoryTimes;
+
+		if (FParse::Value(*Params, TEXT("TrajectoryTimes="), trajectoryTimes, false))
+		{
+			TArray<FString> times;
+			trajectoryTimes.ParseIntoArray(times, TEXT(","));
+			OutOptions.TrajectoryTimes.Reset();
+
+			for (const FString& time : times)
+			{
+				OutOptions.TrajectoryTimes.Add(FCString::Atof(*time));
+			}
+		}
+
+		OutOptions.NumSamples = FMath::Max(OutOptions.NumSamples, 1);
+		OutOptions.NumAnimations = FMath::Clamp(OutOptions.NumAnimations, 1, OutOptions.NumSamples);
+		OutOptions.NumBones = FMath::Max(OutOptions.NumBones, 0);
+		OutOptions.NumQueries = FMath::Max(OutOptions.NumQueries, 1);
+		OutOptions.NumFrames = FMath::Max(OutOptions.NumFrames, 1);
+	}
+
+#if WITH_EDITOR
+	// The same locomotion as the synthetic rows, authored as raw tracks of a transient skeleton: the root walks and
+	// turns, the bones swing around it. The clips go through the full build and playback like real ones.
+	USkeleton* CreateSyntheticClips(const FBenchmarkOptions& Options, float AnimationSampling, TArray<UAnimSequence*>& OutAnimations)
+	{
+		USkeleton* skeleton = NewObject<USkeleton>(GetTransientPackage(), NAME_None, RF_Transient);
+		skeleton->AddToRoot();
+
+		// The reference skeleton is rebuilt once the modifier goes out of scope:
+		{
+			FReferenceSkeletonModifier modifier{skeleton};
+			modifier.Add(FMeshBoneInfo{TEXT("root"), TEXT("root"), INDEX_NONE}, FTransform::Identity);
+
+			for (int32 boneIndex = 0; boneIndex < Options.NumBones; ++boneIndex)
+			{
+				modifier.Add(FMeshBoneInfo{GetSyntheticBoneName(boneIndex), GetSyntheticBoneName(boneIndex).ToString(), 0}, FTransform::Identity);
+			}
+		}
+
+		FRandomStream randomStream{Options.Seed};
+		OutAnimations.Reset();
+
+		for (int32 animationIndex = 0; animationIndex < Options.NumAnimations; ++animationIndex)
+		{
+			const int32 numSamples = FMath::Max(Options.NumSamples / Options.NumAnimations + (animationIndex < Options.NumSamples % Options.NumAnimations ? 1 : 0), 2);
+			const float speed = randomStream.FRandRange(0.0f, 600.0f);
+			const float turnRate = randomStream.FRandRange(-2.0f, 2.0f);
+			const float stepRate = randomStream.FRandRange(4.0f, 12.0f);
+
+			UAnimSequence* animation = NewObject<UAnimSequence>(GetTransientPackage(), NAME_None, RF_Transient);
+			animation->AddToRoot();
+			animation->SetSkeleton(skeleton);
+			animation->SetRawNumberOfFrame(numSamples);
+			animation->SequenceLength = (numSamples - 1) * AnimationSampling;
+			animation->bEnableRootMotion = true;
+
+			FRawAnimSequenceTrack rootTrack;
+			FVector rootPosition = FVector::ZeroVector;
+			float rootYaw = 0.0f;
+
+			for (int32 keyIndex = 0; keyIndex < numSamples; ++keyIndex)
+			{
+				const float time = keyIndex * AnimationSampling;
+				const float currentSpeed = speed * (1.0f + 0.25f * FMath::Sin(0.5f * time));
+				const FQuat rootRotation{FVector::UpVector, rootYaw};
+				rootTrack.PosKeys.Add(rootPosition);
+				rootTrack.RotKeys.Add(rootRotation);
+				rootTrack.ScaleKeys.Add(FVector::OneVector);
+				rootPosition += rootRotation.RotateVector(FVector{currentSpeed * AnimationSampling, 0.0f, 0.0f});
+				rootYaw += turnRate * FMath::Cos(0.3f * time) * AnimationSampling;
+			}
+
+			animation->AddNewRawTrack(TEXT("root"), &rootTrack);
+
+			for (int32 boneIndex = 0; boneIndex < Options.NumBones; ++boneIndex)
+			{
+				FRawAnimSequenceTrack boneTrack;
+
+				for (int32 keyIndex = 0; keyIndex < numSamples; ++keyIndex)
+				{
+					const float time = keyIndex * AnimationSampling;
+					const float currentSpeed = speed * (1.0f + 0.25f * FMath::Sin(0.5f * time));
+					const float bonePhase = stepRate * time + boneIndex * PI / 3.0f;
+					boneTrack.PosKeys.Add(FVector{20.0f * boneIndex + 0.05f * currentSpeed * FMath::Sin(bonePhase), (boneIndex % 2 == 0 ? 15.0f : -15.0f) + 2.0f * FMath::Cos(bonePhase), 10.0f * boneIndex + 5.0f * FMath::Abs(FMath::Sin(bonePhase))});
+					boneTrack.RotKeys.Add(FQuat{FVector::RightVector, 0.5f * FMath::Sin(bonePhase)});
+					boneTrack.ScaleKeys.Add(FVector::OneVector);
+				}
+
+				animation->AddNewRawTrack(GetSyntheticBoneName(boneIndex), &boneTrack);
+			}
+
+			// Compresses the raw tracks, which is what sampling reads:
+			animation->PostProcessSequence();
+			OutAnimations.Add(animation);
+		}
+
+		return skeleton;
+	}
+#endif //WITH_EDITOR
+
+	// Queries sit between two random rows with some noise on top, like the queries a moving character makes.
+	void GenerateQueries(const FMotionFeatureDatabase& Database, int32 NumQueries, int32 Seed, TArray<float>& OutQueries)
+	{
+		FRandomStream randomStream{Seed};
+		const int32 numDimensions = Database.GetNumDimensions();
+		OutQueries.SetNumUninitialized(NumQueries * numDimensions);
+
+		for (int32 queryIndex = 0; queryIndex < NumQueries; ++queryIndex)
+		{
+			const float* first = Database.GetFeatures(randomStream.RandRange(0, Database.GetNumSamples() - 1));
+			const float* second = Database.GetFeatures(randomStream.RandRange(0, Database.GetNumSamples() - 1));
+			float* query = OutQueries.GetData() + queryIndex * numDimensions;
+
+			for (int32 dimension = 0; dimension < numDimensions; ++dimension)
+			{
+				query[dimension] = first[dimension] + 0.25f * (second[dimension] - first[dimension]) + 0.1f * randomStream.FRandRange(-1.0f, 1.0f);
+			}
+		}
+	}
+
+	// Runs every query through Settings, ReferenceMatches are the brute-force matches the result agrees with or not.
+	FBenchmarkResult RunQueries(const FString& Name, const FMotionDatabase& Database, const FMotionMatchingSearchSettings& Settings, const TArray<float>& Queries, const TArray<float>& Weights, const TArray<int32>& ReferenceMatches, TArray<int32>* OutMatches = nullptr)
+	{
+		const FMotionFeatureDatabase& featureDatabase = Database.FeatureDatabase;
+		const int32 numQueries = Queries.Num() / featureDatabase.GetNumDimensions();
+
+		FBenchmarkResult result;
+		result.Name = Name;
+		result.AllocatedBytes = Database.GetAllocatedSize();
+
+		TArray<double> latencies;
+		latencies.Reserve(numQueries);
+		uint64 totalCycles = 0;
+		int64 totalCandidates = 0;
+		int32 numAgreements = 0;
+
+		if (OutMatches)
+		{
+			OutMatches->Reset(numQueries);
+		}
+
+		for (int32 queryIndex = 0; queryIndex < numQueries; ++queryIndex)
+		{
+			const float* query = Queries.GetData() + queryIndex * featureDatabase.GetNumDimensions();
+			FMotionMatchingSearchResult searchResult;
+			FMotionMatchingSearchStats searchStats;
+
+			const uint64 startCycles = FPlatformTime::Cycles64();
+			MotionMatchingSearch::FindLowestCost(Settings, featureDatabase, Database.SearchIndex, query, Weights.GetData(), searchResult, searchStats);
+			const uint64 cycles = FPlatformTime::Cycles64() - startCycles;
+
+			totalCycles += cycles;
+			totalCandidates += searchStats.CandidatesEvaluated;
+			latencies.Add(CyclesToMilliseconds(cycles) * 1000.0);
+			numAgreements += (ReferenceMatches.IsValidIndex(queryIndex) && ReferenceMatches[queryIndex] == searchResult.SampleIndex) ? 1 : 0;
+
+			if (OutMatches)
+			{
+				OutMatches->Add(searchResult.SampleIndex);
+			}
+		}
+
+		latencies.Sort();
+		result.NanosecondsPerCandidate = totalCandidates > 0 ? CyclesToMilliseconds(totalCycles) * 1.e6 / totalCandidates : 0.0;
+		result.CandidatesPerQuery = static_cast<double>(totalCandidates) / numQueries;
+		result.P50Microseconds = GetPercentile(latencies, 0.5f);
+		result.P99Microseconds = GetPercentile(latencies, 0.99f);
+		result.Agreement = ReferenceMatches.Num() > 0 ? static_cast<float>(numAgreements) / numQueries : 1.0f;
+
+		return result;
+	}
+
+	void LogResult(const FBenchmarkResult& Result)
+	{
+		UE_LOG(LogMotionMatching, Display, TEXT("%-28s build %9.2f ms  memory %9.1f KB  %7.2f ns/candidate  %9.1f candidates  p50 %8.1f us  p99 %8.1f us  agreement %6.2f%%"),
+			*Result.Name, Result.BuildMilliseconds, Result.AllocatedBytes / 1024.0, Result.NanosecondsPerCandidate, Result.CandidatesPerQuery,
+			Result.P50Microseconds, Result.P99Microseconds, Result.Agreement * 100.0f);
+	}
+
+	bool BenchmarkDatabase(const FString& Prefix, const FBenchmarkOptions& Options, TFunctionRef<void(FMotionDatabase&, const FMotionDatabaseSettings&)> BuildFunction, const FMotionDatabaseSettings& BaseSettings, TArray<FBenchmarkResult>& OutResults)
+	{
+		const auto buildDatabase = [&](EMotionMatchingSearchMode SearchMode, EMotionFeatureQuantization Quantization, double& OutBuildMilliseconds)
+		{
+			FMotionDatabaseSettings settings{BaseSettings};
+			settings.SearchMode = SearchMode;
+			settings.Quantization = Quantization;
+
+			TUniquePtr<FMotionDatabase> database = MakeUnique<FMotionDatabase>();
+			const uint64 startCycles = FPlatformTime::Cycles64();
+			BuildFunction(*database, settings);
+			OutBuildMilliseconds = CyclesToMilliseconds(FPlatformTime::Cycles64() - startCycles);
+
+			return database;
+		};
+
+		double buildMilliseconds = 0.0;
+		const TUniquePtr<FMotionDatabase> bruteForceDatabase = buildDatabase(EMotionMatchingSearchMode::BruteForce, EMotionFeatureQuantization::None, buildMilliseconds);
+
+		if (bruteForceDatabase->FeatureDatabase.GetNumSamples() == 0)
+		{
+			UE_LOG(LogMotionMatching, Error, TEXT("%s: the database has no samples"), *Prefix);
+
+			return false;
+		}
+
+		TArray<float> weights;
+		bruteForceDatabase->FeatureDatabase.ExpandWeights(BaseSettings.IndexWeights, weights);
+		TArray<float> queries;
+		GenerateQueries(bruteForceDatabase->FeatureDatabase, Options.NumQueries, Options.Seed, queries);
+
+		UE_LOG(LogMotionMatching, Display, TEXT("%s: %d samples, %d dimensions, %d queries"), *Prefix, bruteForceDatabase->FeatureDatabase.GetNumSamples(), bruteForceDatabase->FeatureDatabase.GetNumDimensions(), Options.NumQueries);
+
+		// The scalar brute-force matches are the reference every other configuration is compared with:
+		TArray<int32> referenceMatches;
+		FMotionMatchingSearchSettings searchSettings;
+		searchSettings.CostKernel = EMotionMatchingCostKernel::Scalar;
+		OutResults.Add(RunQueries(Prefix + TEXT(" BruteForce Scalar"), *bruteForceDatabase, searchSettings, queries, weights, TArray<int32>{}, &referenceMatches));
+		OutResults.Last().BuildMilliseconds = buildMilliseconds;
+
+		for (const EMotionMatchingCostKernel costKernel : {EMotionMatchingCostKernel::SSE, EMotionMatchingCostKernel::AVX2, EMotionMatchingCostKernel::NEON})
+		{
+			if (MotionMatchingCostKernel::Resolve(costKernel) == costKernel)
+			{
+				searchSettings.CostKernel = costKernel;
+				OutResults.Add(RunQueries(Prefix + TEXT(" BruteForce ") + StaticEnum<EMotionMatchingCostKernel>()->GetNameStringByValue(static_cast<int64>(costKernel)), *bruteForceDatabase, searchSettings, queries, weights, referenceMatches));
+				OutResults.Last().BuildMilliseconds = buildMilliseconds;
+			}
+		}
+
+		searchSettings.CostKernel = EMotionMatchingCostKernel::Auto;
+		searchSettings.ParallelSearchThreshold = 1;
+		OutResults.Add(RunQueries(Prefix + TEXT(" BruteForce Parallel"), *bruteForceDatabase, searchSettings, queries, weights, referenceMatches));
+		OutResults.Last().BuildMilliseconds = buildMilliseconds;
+		searchSettings.ParallelSearchThreshold = 0;
+
+		for (const EMotionFeatureQuantization quantization : {EMotionFeatureQuantization::Int16, EMotionFeatureQuantization::Int8})
+		{
+			const TUniquePtr<FMotionDatabase> database = buildDatabase(EMotionMatchingSearchMode::BruteForce, quantization, buildMilliseconds);
+			OutResults.Add(RunQueries(Prefix + TEXT(" BruteForce ") + StaticEnum<EMotionFeatureQuantization>()->GetNameStringByValue(static_cast<int64>(quantization)), *database, searchSettings, queries, weights, referenceMatches));
+			OutResults.Last().BuildMilliseconds = buildMilliseconds;
+		}
+
+		searchSettings.CandidateBudget = Options.CandidateBudget;
+
+		for (const EMotionMatchingSearchMode searchMode : {EMotionMatchingSearchMode::KDTree, EMotionMatchingSearchMode::AABBTree, EMotionMatchingSearchMode::Approximate})
+		{
+			const TUniquePtr<FMotionDatabase> database = buildDatabase(searchMode, EMotionFeatureQuantization::None, buildMilliseconds);
+			searchSettings.SearchMode = searchMode;
+			OutResults.Add(RunQueries(Prefix + TEXT(" ") + StaticEnum<EMotionMatchingSearchMode>()->GetNameStringByValue(static_cast<int64>(searchMode)), *database, searchSettings, queries, weights, referenceMatches));
+			OutResults.Last().BuildMilliseconds = buildMilliseconds;
+		}
+
+		return true;
+	}
+
+	// Times what depends on real clips: a full runtime build, the bone transform extraction part of it, and playback
+	// through FAnimContainer the way an inertializing node evaluates it. Every frame decays the offsets and samples the
+	// blended pose, every 0.2 seconds a transition to a random sample starts from the pose on screen.
+	bool BenchmarkClips(const FString& Name, const FMotionDatabaseSettings& Settings, const FBenchmarkOptions& Options)
+	{
+		if (!Settings.Skeleton || Settings.AnimationSampling <= 0.0f)
+		{
+			UE_LOG(LogMotionMatching, Error, TEXT("%s: no skeleton or sampling, the clips are not benchmarked"), *Name);
+
+			return false;
+		}
+
+		const FReferenceSkeleton& refSkeleton = Settings.Skeleton->GetReferenceSkeleton();
+		TArray<int32> boneIndices;
+		FBoneToRootTransforms::ResolveBoneIndices(refSkeleton, Settings.BoneNames, boneIndices);
+
+		uint64 transformCycles = 0;
+
+		for (const UAnimSequence* animation : Settings.Animations)
+		{
+			if (animation)
+			{
+				const uint64 startCycles = FPlatformTime::Cycles64();
+				const FBoneToRootTransforms boneToRootTransforms{animation, boneIndices, Settings.AnimationSampling, true};
+				transformCycles += FPlatformTime::Cycles64() - startCycles;
+			}
+		}
+
+		FMotionDatabase database;
+		const uint64 buildStartCycles = FPlatformTime::Cycles64();
+		database.Build(Settings);
+		const double buildMilliseconds = CyclesToMilliseconds(FPlatformTime::Cycles64() - buildStartCycles);
+		const FMotionFeatureDatabase& featureDatabase = database.FeatureDatabase;
+
+		if (featureDatabase.GetNumSamples() == 0)
+		{
+			UE_LOG(LogMotionMatching, Error, TEXT("%s: the database has no samples"), *Name);
+
+			return false;
+		}
+
+		TArray<FBoneIndexType> requiredBones;
+
+		for (int32 boneIndex = 0; boneIndex < refSkeleton.GetNum(); ++boneIndex)
+		{
+			requiredBones.Add(boneIndex);
+		}
+
+		FMemMark mark{FMemStack::Get()};
+		FBoneContainer boneContainer{requiredBones, FCurveEvaluationOption{false}, *const_cast<USkeleton*>(Settings.Skeleton)};
+		FCompactPose pose;
+		pose.SetBoneContainer(&boneContainer);
+		FBlendedCurve curve;
+		curve.InitFrom(boneContainer);
+
+		FAnimContainer animContainer;
+		animContainer.Init(Settings.Animations, Settings.AnimationSampling);
+		animContainer.SetMirrorTable(database.MirrorTable);
+
+		constexpr float DeltaTime = 1.0f / 30.0f;
+		constexpr int32 FramesPerTransition = 6;
+		FRandomStream randomStream{Options.Seed};
+		FAnimKey animKey = featureDatabase.GetAnimKey(0);
+		TArray<double> frameLatencies;
+		TArray<double> transitionLatencies;
+		frameLatencies.Reserve(Options.NumFrames);
+		transitionLatencies.Reserve(Options.NumFrames / FramesPerTransition + 1);
+
+		for (int32 frameIndex = 0; frameIndex < Options.NumFrames; ++frameIndex)
+		{
+			if (frameIndex % FramesPerTransition == 0)
+			{
+				const FAnimKey& newAnimKey = featureDatabase.GetAnimKey(randomStream.RandRange(0, featureDatabase.GetNumSamples() - 1));
+				const uint64 startCycles = FPlatformTime::Cycles64();
+				animContainer.StartTransition(boneContainer, animKey, newAnimKey, 1.0f, true);
+				transitionLatencies.Add(CyclesToMilliseconds(FPlatformTime::Cycles64() - startCycles) * 1000.0);
+				animKey = newAnimKey;
+			}
+
+			const uint64 startCycles = FPlatformTime::Cycles64();
+			animContainer.DecayTransition(DeltaTime, 0.1f);
+			animContainer.GetBlendedPose(pose, curve, animKey, 1.0f);
+			frameLatencies.Add(CyclesToMilliseconds(FPlatformTime::Cycles64() - startCycles) * 1000.0);
+
+			animKey.StartTime = FMath::Min(animKey.StartTime + DeltaTime, animContainer.GetAnimation(animKey).SequenceLength);
+		}
+
+		frameLatencies.Sort();
+		transitionLatencies.Sort();
+
+		UE_LOG(LogMotionMatching, Display, TEXT("%s: build %.2f ms, of which bone transforms %.2f ms, for %d clips and %d samples"),
+			*Name, buildMilliseconds, CyclesToMilliseconds(transformCycles), Settings.Animations.Num(), featureDatabase.GetNumSamples());
+		UE_LOG(LogMotionMatching, Display, TEXT("%s: GetBlendedPose p50 %.1f us  p99 %.1f us over %d frames, StartTransition p50 %.1f us  p99 %.1f us over %d transitions, %d bones"),
+			*Name, GetPercentile(frameLatencies, 0.5f), GetPercentile(frameLatencies, 0.99f), frameLatencies.Num(),
+			GetPercentile(transitionLatencies, 0.5f), GetPercentile(transitionLatencies, 0.99f), transitionLatencies.Num(), refSkeleton.GetNum());
+
+		return true;
+	}
+
+	void SaveCsv(const FString& Path, const TArray<FBenchmarkResult>& Results)
+	{
+		FString csv = TEXT("Name,BuildMs,MemoryBytes,NsPerCandidate,CandidatesPerQuery,P50Us,P99Us,Agreement\n");
+
+		for (const FBenchmarkResult& result : Results)
+		{
+			csv += FString::Printf(TEXT("%s,%f,%llu,%f,%f,%f,%f,%f\n"), *result.Name, result.BuildMilliseconds, static_cast<uint64>(result.AllocatedBytes), result.NanosecondsPerCandidate,
+				result.CandidatesPerQuery, result.P50Microseconds, result.P99Microseconds, result.Agreement);
+		}
+
+		if (!FFileHelper::SaveStringToFile(csv, *Path))
+		{
+			UE_LOG(LogMotionMatching, Error, TEXT("Could not write %s"), *Path);
+		}
+	}
+}
+
+UMotionMatchingBenchmarkCommandlet::UMotionMatchingBenchmarkCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = false;
+	LogToConsole = true;
+}
+
+int32 UMotionMatchingBenchmarkCommandlet::Main(const FString& Params)
+{
+	FBenchmarkOptions options;
+	ParseOptions(Params, options);
+
+	TArray<FBenchmarkResult> results;
+	bool bSucceeded = true;
+
+	// Synthetic rows only need the settings that shape them, they keep the search benchmark free of sampling costs:
+	FMotionDatabaseSettings syntheticSettings;
+	syntheticSettings.AnimationSampling = 1.0f / 30.0f;
+	syntheticSettings.TrajectoryTimes = options.TrajectoryTimes;
+
+	for (int32 boneIndex = 0; boneIndex < options.NumBones; ++boneIndex)
+	{
+		syntheticSettings.BoneNames.Add(GetSyntheticBoneName(boneIndex));
+	}
+
+	TArray<float> syntheticFeatures;
+	TArray<int32> syntheticAnimationNumSamples;
+	FMotionFeatureDatabase::GenerateSyntheticFeatures(options.NumSamples, options.NumAnimations, options.NumBones, syntheticSettings.AnimationSampling, options.TrajectoryTimes, options.Seed, syntheticFeatures, syntheticAnimationNumSamples);
+
+	bSucceeded &= BenchmarkDatabase(TEXT("Synthetic"), options, [&](FMotionDatabase& Database, const FMotionDatabaseSettings& Settings)
+	{
+		Database.BuildFromFeatures(Settings, syntheticFeatures, syntheticAnimationNumSamples);
+	}, syntheticSettings, results);
+
+#if WITH_EDITOR
+	// Clips of the same size, for the build and playback costs the rows skip:
+	FMotionDatabaseSettings clipSettings{syntheticSettings};
+	USkeleton* syntheticSkeleton = CreateSyntheticClips(options, clipSettings.AnimationSampling, clipSettings.Animations);
+	clipSettings.Skeleton = syntheticSkeleton;
+	bSucceeded &= BenchmarkClips(TEXT("Synthetic clips"), clipSettings, options);
+
+	for (UAnimSequence* animation : clipSettings.Animations)
+	{
+		animation->RemoveFromRoot();
+	}
+
+	syntheticSkeleton->RemoveFromRoot();
+#else
+	UE_LOG(LogMotionMatching, Warning, TEXT("Synthetic clips need editor data, only the synthetic rows are benchmarked"));
+#endif //WITH_EDITOR
+
+	if (!options.DatabasePath.IsEmpty())
+	{
+		const UMotionDatabaseAsset* asset = LoadObject<UMotionDatabaseAsset>(nullptr, *options.DatabasePath);
+
+		if (asset)
+		{
+			bSucceeded &= BenchmarkClips(asset->GetName(), asset->GetSettings(), options);
+			bSucceeded &= BenchmarkDatabase(asset->GetName(), options, [](FMotionDatabase& Database, const FMotionDatabaseSettings& Settings)
+			{
+				Database.Build(Settings);
+			}, asset->GetSettings(), results);
+		}
+		else
+		{
+			UE_LOG(LogMotionMatching, Error, TEXT("Could not load motion database %s"), *options.DatabasePath);
+			bSucceeded = false;
+		}
+	}
+
+	for (const FBenchmarkResult& result : results)
+	{
+		LogResult(result);
+
+		if (options.MinAgreement > 0.0f && result.Agreement < options.MinAgreement)
+		{
+			UE_LOG(LogMotionMatching, Error, TEXT("%s agrees with brute force on %.2f%% of the queries, below the required %.2f%%"), *result.Name, result.Agreement * 100.0f, options.MinAgreement * 100.0f);
+			bSucceeded = false;
+		}
+
+		if (options.MaxP99Microseconds > 0.0f && result.P99Microseconds > options.MaxP99Microseconds)
+		{
+			UE_LOG(LogMotionMatching, Error, TEXT("%s has a p99 latency of %.1f us, above the allowed %.1f us"), *result.Name, result.P99Microseconds, options.MaxP99Microseconds);
+			bSucceeded = false;
+		}
+	}
+
+	if (!options.CsvPath.IsEmpty())
+	{
+		SaveCsv(options.CsvPath, results);
+	}
+
+	return bSucceeded ? 0 : 1;
+}
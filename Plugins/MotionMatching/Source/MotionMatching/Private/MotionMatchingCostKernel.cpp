@@ -0,0 +1,577 @@
+#include "MotionMatchingCostKernel.h"
+#include "MotionFeatureDatabase.h"
+
+#if PLATFORM_ENABLE_VECTORINTRINSICS_NEON
+	#define MOTIONMATCHING_WITH_NEON 1
+	#include <arm_neon.h>
+#elif PLATFORM_ENABLE_VECTORINTRINSICS
+	#define MOTIONMATCHING_WITH_SSE 1
+	#include <immintrin.h>
+	#if defined(_M_X64) || defined(__x86_64__)
+		#define MOTIONMATCHING_WITH_AVX2 1
+		#if defined(_MSC_VER)
+			#include <intrin.h>
+			#define MOTIONMATCHING_AVX2_TARGET
+		#else
+			#define MOTIONMATCHING_AVX2_TARGET __attribute__((target("avx2")))
+		#endif
+	#endif
+#endif
+
+#ifndef MOTIONMATCHING_WITH_NEON
+	#define MOTIONMATCHING_WITH_NEON 0
+#endif
+#ifndef MOTIONMATCHING_WITH_SSE
+	#define MOTIONMATCHING_WITH_SSE 0
+#endif
+#ifndef MOTIONMATCHING_WITH_AVX2
+	#define MOTIONMATCHING_WITH_AVX2 0
+#endif
+
+namespace
+{
+	constexpr int32 BlockWidth = FMotionFeatureDatabase::BlockWidth;
+
+	using FActiveDimensions = MotionMatchingCostKernel::FActiveDimensions;
+
+	void ReduceBlock(const float* LaneCosts, int32 BlockFirstSample, int32 BeginLane, int32 EndLane, FMotionMatchingSearchResult& InOutResult)
+	{
+		for (int32 lane = BeginLane; lane < EndLane; ++lane)
+		{
+			const int32 sampleIndex = BlockFirstSample + lane;
+
+			if (LaneCosts[lane] < InOutResult.Cost || (LaneCosts[lane] == InOutResult.Cost && sampleIndex < InOutResult.SampleIndex))
+			{
+				InOutResult.Cost = LaneCosts[lane];
+				InOutResult.SampleIndex = sampleIndex;
+			}
+		}
+	}
+
+	// Calls BlockFunction(BlockIndex, BeginLane, EndLane) for every block overlapping [BeginSample, EndSample).
+	template<typename FunctionType>
+	void ForEachBlock(int32 BeginSample, int32 EndSample, FunctionType BlockFunction)
+	{
+		for (int32 blockIndex = BeginSample / BlockWidth; blockIndex * BlockWidth < EndSample; ++blockIndex)
+		{
+			const int32 blockFirstSample = blockIndex * BlockWidth;
+			const int32 beginLane = FMath::Max(BeginSample - blockFirstSample, 0);
+			const int32 endLane = FMath::Min(EndSample - blockFirstSample, BlockWidth);
+
+			BlockFunction(blockIndex, beginLane, endLane);
+		}
+	}
+
+	void FindLowestCostScalar(const FMotionFeatureDatabase& Database, const FActiveDimensions& Active, int32 BeginSample, int32 EndSample, FMotionMatchingSearchResult& InOutResult)
+	{
+		float laneCosts[BlockWidth];
+
+		ForEachBlock(BeginSample, EndSample, [&](int32 BlockIndex, int32 BeginLane, int32 EndLane)
+		{
+			const float* block = Database.GetFeatureBlock(BlockIndex);
+
+			for (int32 lane = BeginLane; lane < EndLane; ++lane)
+			{
+				float cost = 0.0f;
+
+				for (int32 activeIndex = 0; activeIndex < Active.Num(); ++activeIndex)
+				{
+					const float difference = Active.Query[activeIndex] - block[Active.Dimensions[activeIndex] * BlockWidth + lane];
+					float term = difference * difference;
+					term = term * Active.Weights[activeIndex];
+					cost = cost + term;
+				}
+
+				laneCosts[lane] = cost;
+			}
+
+			ReduceBlock(laneCosts, BlockIndex * BlockWidth, BeginLane, EndLane, InOutResult);
+		});
+	}
+
+	// Scale and offset of every active dimension, a stored value q stands for q * Scale + Offset.
+	struct FActiveDequantization
+	{
+		FActiveDequantization(const FMotionFeatureDatabase& Database, const FActiveDimensions& Active)
+		{
+			for (int32 activeIndex = 0; activeIndex < Active.Num(); ++activeIndex)
+			{
+				Scales.Add(Database.GetQuantizationScale(Active.Dimensions[activeIndex]));
+				Offsets.Add(Database.GetQuantizationOffset(Active.Dimensions[activeIndex]));
+			}
+		}
+
+		TArray<float, TInlineAllocator<64>> Scales;
+		TArray<float, TInlineAllocator<64>> Offsets;
+	};
+
+	// The quantized kernels dequantize with a separate multiply and add in every lane, so that they agree with each
+	// other and with the error measured by FMotionFeatureDatabase::Quantize.
+	template<typename ValueType>
+	void FindLowestCostQuantizedScalar(const FMotionFeatureDatabase& Database, const FActiveDimensions& Active, int32 BeginSample, int32 EndSample, FMotionMatchingSearchResult& InOutResult)
+	{
+		const FActiveDequantization dequantization{Database, Active};
+		float laneCosts[BlockWidth];
+
+		ForEachBlock(BeginSample, EndSample, [&](int32 BlockIndex, int32 BeginLane, int32 EndLane)
+		{
+			const ValueType* block = Database.GetQuantizedBlock<ValueType>(BlockIndex);
+
+			for (int32 lane = BeginLane; lane < EndLane; ++lane)
+			{
+				float cost = 0.0f;
+
+				for (int32 activeIndex = 0; activeIndex < Active.Num(); ++activeIndex)
+				{
+					float value = static_cast<float>(block[Active.Dimensions[activeIndex] * BlockWidth + lane]) * dequantization.Scales[activeIndex];
+					value = value + dequantization.Offsets[activeIndex];
+					const float difference = Active.Query[activeIndex] - value;
+					float term = difference * difference;
+					term = term * Active.Weights[activeIndex];
+					cost = cost + term;
+				}
+
+				laneCosts[lane] = cost;
+			}
+
+			ReduceBlock(laneCosts, BlockIndex * BlockWidth, BeginLane, EndLane, InOutResult);
+		});
+	}
+
+#if MOTIONMATCHING_WITH_SSE
+	void FindLowestCostSSE(const FMotionFeatureDatabase& Database, const FActiveDimensions& Active, int32 BeginSample, int32 EndSample, FMotionMatchingSearchResult& InOutResult)
+	{
+		alignas(16) float laneCosts[BlockWidth];
+
+		ForEachBlock(BeginSample, EndSample, [&](int32 BlockIndex, int32 BeginLane, int32 EndLane)
+		{
+			const float* block = Database.GetFeatureBlock(BlockIndex);
+			__m128 costLow = _mm_setzero_ps();
+			__m128 costHigh = _mm_setzero_ps();
+
+			for (int32 activeIndex = 0; activeIndex < Active.Num(); ++activeIndex)
+			{
+				const float* values = block + Active.Dimensions[activeIndex] * BlockWidth;
+				const __m128 query = _mm_set1_ps(Active.Query[activeIndex]);
+				const __m128 weight = _mm_set1_ps(Active.Weights[activeIndex]);
+				const __m128 differenceLow = _mm_sub_ps(query, _mm_loadu_ps(values));
+				const __m128 differenceHigh = _mm_sub_ps(query, _mm_loadu_ps(values + 4));
+
+				costLow = _mm_add_ps(costLow, _mm_mul_ps(_mm_mul_ps(differenceLow, differenceLow), weight));
+				costHigh = _mm_add_ps(costHigh, _mm_mul_ps(_mm_mul_ps(differenceHigh, differenceHigh), weight));
+			}
+
+			__m128 minimum = _mm_min_ps(costLow, costHigh);
+			minimum = _mm_min_ps(minimum, _mm_movehl_ps(minimum, minimum));
+			minimum = _mm_min_ss(minimum, _mm_shuffle_ps(minimum, minimum, 1));
+
+			if (_mm_cvtss_f32(minimum) <= InOutResult.Cost)
+			{
+				_mm_store_ps(laneCosts, costLow);
+				_mm_store_ps(laneCosts + 4, costHigh);
+				ReduceBlock(laneCosts, BlockIndex * BlockWidth, BeginLane, EndLane, InOutResult);
+			}
+		});
+	}
+
+	// Sign-extends eight stored values into two vectors of four floats.
+	FORCEINLINE void LoadLanesSSE(const int16* Values, __m128& OutLow, __m128& OutHigh)
+	{
+		const __m128i values = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Values));
+		OutLow = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(values, values), 16));
+		OutHigh = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(values, values), 16));
+	}
+
+	FORCEINLINE void LoadLanesSSE(const int8* Values, __m128& OutLow, __m128& OutHigh)
+	{
+		const __m128i bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(Values));
+		const __m128i values = _mm_srai_epi16(_mm_unpacklo_epi8(bytes, bytes), 8);
+		OutLow = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(values, values), 16));
+		OutHigh = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(values, values), 16));
+	}
+
+	template<typename ValueType>
+	void FindLowestCostQuantizedSSE(const FMotionFeatureDatabase& Database, const FActiveDimensions& Active, int32 BeginSample, int32 EndSample, FMotionMatchingSearchResult& InOutResult)
+	{
+		const FActiveDequantization dequantization{Database, Active};
+		alignas(16) float laneCosts[BlockWidth];
+
+		ForEachBlock(BeginSample, EndSample, [&](int32 BlockIndex, int32 BeginLane, int32 EndLane)
+		{
+			const ValueType* block = Database.GetQuantizedBlock<ValueType>(BlockIndex);
+			__m128 costLow = _mm_setzero_ps();
+			__m128 costHigh = _mm_setzero_ps();
+
+			for (int32 activeIndex = 0; activeIndex < Active.Num(); ++activeIndex)
+			{
+				const __m128 query = _mm_set1_ps(Active.Query[activeIndex]);
+				const __m128 weight = _mm_set1_ps(Active.Weights[activeIndex]);
+				const __m128 scale = _mm_set1_ps(dequantization.Scales[activeIndex]);
+				const __m128 offset = _mm_set1_ps(dequantization.Offsets[activeIndex]);
+				__m128 valuesLow;
+				__m128 valuesHigh;
+				LoadLanesSSE(block + Active.Dimensions[activeIndex] * BlockWidth, valuesLow, valuesHigh);
+
+				const __m128 differenceLow = _mm_sub_ps(query, _mm_add_ps(_mm_mul_ps(valuesLow, scale), offset));
+				const __m128 differenceHigh = _mm_sub_ps(query, _mm_add_ps(_mm_mul_ps(valuesHigh, scale), offset));
+
+				costLow = _mm_add_ps(costLow, _mm_mul_ps(_mm_mul_ps(differenceLow, differenceLow), weight));
+				costHigh = _mm_add_ps(costHigh, _mm_mul_ps(_mm_mul_ps(differenceHigh, differenceHigh), weight));
+			}
+
+			__m128 minimum = _mm_min_ps(costLow, costHigh);
+			minimum = _mm_min_ps(minimum, _mm_movehl_ps(minimum, minimum));
+			minimum = _mm_min_ss(minimum, _mm_shuffle_ps(minimum, minimum, 1));
+
+			if (_mm_cvtss_f32(minimum) <= InOutResult.Cost)
+			{
+				_mm_store_ps(laneCosts, costLow);
+				_mm_store_ps(laneCosts + 4, costHigh);
+				ReduceBlock(laneCosts, BlockIndex * BlockWidth, BeginLane, EndLane, InOutResult);
+			}
+		});
+	}
+#endif //MOTIONMATCHING_WITH_SSE
+
+#if MOTIONMATCHING_WITH_AVX2
+	bool HasAVX2Support()
+	{
+#if defined(_MSC_VER)
+		int32 cpuInfo[4];
+		__cpuid(cpuInfo, 1);
+		const bool bOSXSave = (cpuInfo[2] & (1 << 27)) != 0;
+		const bool bAVX = (cpuInfo[2] & (1 << 28)) != 0;
+
+		if (!bOSXSave || !bAVX || (_xgetbv(0) & 0x6) != 0x6)
+		{
+			return false;
+		}
+
+		__cpuidex(cpuInfo, 7, 0);
+
+		return (cpuInfo[1] & (1 << 5)) != 0;
+#else
+		return __builtin_cpu_supports("avx2");
+#endif
+	}
+
+	MOTIONMATCHING_AVX2_TARGET void FindLowestCostAVX2Block(const float* Block, const FActiveDimensions& Active, float* OutLaneCosts, float& OutMinimumCost)
+	{
+		__m256 cost = _mm256_setzero_ps();
+
+		for (int32 activeIndex = 0; activeIndex < Active.Num(); ++activeIndex)
+		{
+			const __m256 difference = _mm256_sub_ps(_mm256_set1_ps(Active.Query[activeIndex]), _mm256_loadu_ps(Block + Active.Dimensions[activeIndex] * BlockWidth));
+			cost = _mm256_add_ps(cost, _mm256_mul_ps(_mm256_mul_ps(difference, difference), _mm256_set1_ps(Active.Weights[activeIndex])));
+		}
+
+		__m128 minimum = _mm_min_ps(_mm256_castps256_ps128(cost), _mm256_extractf128_ps(cost, 1));
+		minimum = _mm_min_ps(minimum, _mm_movehl_ps(minimum, minimum));
+		minimum = _mm_min_ss(minimum, _mm_shuffle_ps(minimum, minimum, 1));
+
+		_mm256_storeu_ps(OutLaneCosts, cost);
+		OutMinimumCost = _mm_cvtss_f32(minimum);
+	}
+
+	void FindLowestCostAVX2(const FMotionFeatureDatabase& Database, const FActiveDimensions& Active, int32 BeginSample, int32 EndSample, FMotionMatchingSearchResult& InOutResult)
+	{
+		float laneCosts[BlockWidth];
+
+		ForEachBlock(BeginSample, EndSample, [&](int32 BlockIndex, int32 BeginLane, int32 EndLane)
+		{
+			float minimumCost;
+			FindLowestCostAVX2Block(Database.GetFeatureBlock(BlockIndex), Active, laneCosts, minimumCost);
+
+			if (minimumCost <= InOutResult.Cost)
+			{
+				ReduceBlock(laneCosts, BlockIndex * BlockWidth, BeginLane, EndLane, InOutResult);
+			}
+		});
+	}
+
+	MOTIONMATCHING_AVX2_TARGET __m256 LoadLanesAVX2(const int16* Values)
+	{
+		return _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(Values))));
+	}
+
+	MOTIONMATCHING_AVX2_TARGET __m256 LoadLanesAVX2(const int8* Values)
+	{
+		return _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(Values))));
+	}
+
+	template<typename ValueType>
+	MOTIONMATCHING_AVX2_TARGET void FindLowestCostQuantizedAVX2Block(const ValueType* Block, const FActiveDimensions& Active, const FActiveDequantization& Dequantization, float* OutLaneCosts, float& OutMinimumCost)
+	{
+		__m256 cost = _mm256_setzero_ps();
+
+		for (int32 activeIndex = 0; activeIndex < Active.Num(); ++activeIndex)
+		{
+			const __m256 values = LoadLanesAVX2(Block + Active.Dimensions[activeIndex] * BlockWidth);
+			const __m256 dequantized = _mm256_add_ps(_mm256_mul_ps(values, _mm256_set1_ps(Dequantization.Scales[activeIndex])), _mm256_set1_ps(Dequantization.Offsets[activeIndex]));
+			const __m256 difference = _mm256_sub_ps(_mm256_set1_ps(Active.Query[activeIndex]), dequantized);
+			cost = _mm256_add_ps(cost, _mm256_mul_ps(_mm256_mul_ps(difference, difference), _mm256_set1_ps(Active.Weights[activeIndex])));
+		}
+
+		__m128 minimum = _mm_min_ps(_mm256_castps256_ps128(cost), _mm256_extractf128_ps(cost, 1));
+		minimum = _mm_min_ps(minimum, _mm_movehl_ps(minimum, minimum));
+		minimum = _mm_min_ss(minimum, _mm_shuffle_ps(minimum, minimum, 1));
+
+		_mm256_storeu_ps(OutLaneCosts, cost);
+		OutMinimumCost = _mm_cvtss_f32(minimum);
+	}
+
+	template<typename ValueType>
+	void FindLowestCostQuantizedAVX2(const FMotionFeatureDatabase& Database, const FActiveDimensions& Active, int32 BeginSample, int32 EndSample, FMotionMatchingSearchResult& InOutResult)
+	{
+		const FActiveDequantization dequantization{Database, Active};
+		float laneCosts[BlockWidth];
+
+		ForEachBlock(BeginSample, EndSample, [&](int32 BlockIndex, int32 BeginLane, int32 EndLane)
+		{
+			float minimumCost;
+			FindLowestCostQuantizedAVX2Block(Database.GetQuantizedBlock<ValueType>(BlockIndex), Active, dequantization, laneCosts, minimumCost);
+
+			if (minimumCost <= InOutResult.Cost)
+			{
+				ReduceBlock(laneCosts, BlockIndex * BlockWidth, BeginLane, EndLane, InOutResult);
+			}
+		});
+	}
+#endif //MOTIONMATCHING_WITH_AVX2
+
+#if MOTIONMATCHING_WITH_NEON
+	void FindLowestCostNEON(const FMotionFeatureDatabase& Database, const FActiveDimensions& Active, int32 BeginSample, int32 EndSample, FMotionMatchingSearchResult& InOutResult)
+	{
+		float laneCosts[BlockWidth];
+
+		ForEachBlock(BeginSample, EndSample, [&](int32 BlockIndex, int32 BeginLane, int32 EndLane)
+		{
+			const float* block = Database.GetFeatureBlock(BlockIndex);
+			float32x4_t costLow = vdupq_n_f32(0.0f);
+			float32x4_t costHigh = vdupq_n_f32(0.0f);
+
+			for (int32 activeIndex = 0; activeIndex < Active.Num(); ++activeIndex)
+			{
+				const float* values = block + Active.Dimensions[activeIndex] * BlockWidth;
+				const float32x4_t query = vdupq_n_f32(Active.Query[activeIndex]);
+				const float32x4_t weight = vdupq_n_f32(Active.Weights[activeIndex]);
+				const float32x4_t differenceLow = vsubq_f32(query, vld1q_f32(values));
+				const float32x4_t differenceHigh = vsubq_f32(query, vld1q_f32(values + 4));
+
+				costLow = vaddq_f32(costLow, vmulq_f32(vmulq_f32(differenceLow, differenceLow), weight));
+				costHigh = vaddq_f32(costHigh, vmulq_f32(vmulq_f32(differenceHigh, differenceHigh), weight));
+			}
+
+			const float32x4_t minimum = vminq_f32(costLow, costHigh);
+			float32x2_t pairMinimum = vpmin_f32(vget_low_f32(minimum), vget_high_f32(minimum));
+			pairMinimum = vpmin_f32(pairMinimum, pairMinimum);
+
+			if (vget_lane_f32(pairMinimum, 0) <= InOutResult.Cost)
+			{
+				vst1q_f32(laneCosts, costLow);
+				vst1q_f32(laneCosts + 4, costHigh);
+				ReduceBlock(laneCosts, BlockIndex * BlockWidth, BeginLane, EndLane, InOutResult);
+			}
+		});
+	}
+
+	// Sign-extends eight stored values into two vectors of four floats.
+	FORCEINLINE void LoadLanesNEON(const int16* Values, float32x4_t& OutLow, float32x4_t& OutHigh)
+	{
+		const int16x8_t values = vld1q_s16(Values);
+		OutLow = vcvtq_f32_s32(vmovl_s16(vget_low_s16(values)));
+		OutHigh = vcvtq_f32_s32(vmovl_s16(vget_high_s16(values)));
+	}
+
+	FORCEINLINE void LoadLanesNEON(const int8* Values, float32x4_t& OutLow, float32x4_t& OutHigh)
+	{
+		const int16x8_t values = vmovl_s8(vld1_s8(Values));
+		OutLow = vcvtq_f32_s32(vmovl_s16(vget_low_s16(values)));
+		OutHigh = vcvtq_f32_s32(vmovl_s16(vget_high_s16(values)));
+	}
+
+	template<typename ValueType>
+	void FindLowestCostQuantizedNEON(const FMotionFeatureDatabase& Database, const FActiveDimensions& Active, int32 BeginSample, int32 EndSample, FMotionMatchingSearchResult& InOutResult)
+	{
+		const FActiveDequantization dequantization{Database, Active};
+		float laneCosts[BlockWidth];
+
+		ForEachBlock(BeginSample, EndSample, [&](int32 BlockIndex, int32 BeginLane, int32 EndLane)
+		{
+			const ValueType* block = Database.GetQuantizedBlock<ValueType>(BlockIndex);
+			float32x4_t costLow = vdupq_n_f32(0.0f);
+			float32x4_t costHigh = vdupq_n_f32(0.0f);
+
+			for (int32 activeIndex = 0; activeIndex < Active.Num(); ++activeIndex)
+			{
+				const float32x4_t query = vdupq_n_f32(Active.Query[activeIndex]);
+				const float32x4_t weight = vdupq_n_f32(Active.Weights[activeIndex]);
+				const float32x4_t scale = vdupq_n_f32(dequantization.Scales[activeIndex]);
+				const float32x4_t offset = vdupq_n_f32(dequantization.Offsets[activeIndex]);
+				float32x4_t valuesLow;
+				float32x4_t valuesHigh;
+				LoadLanesNEON(block + Active.Dimensions[activeIndex] * BlockWidth, valuesLow, valuesHigh);
+
+				const float32x4_t differenceLow = vsubq_f32(query, vaddq_f32(vmulq_f32(valuesLow, scale), offset));
+				const float32x4_t differenceHigh = vsubq_f32(query, vaddq_f32(vmulq_f32(valuesHigh, scale), offset));
+
+				costLow = vaddq_f32(costLow, vmulq_f32(vmulq_f32(differenceLow, differenceLow), weight));
+				costHigh = vaddq_f32(costHigh, vmulq_f32(vmulq_f32(differenceHigh, differenceHigh), weight));
+			}
+
+			const float32x4_t minimum = vminq_f32(costLow, costHigh);
+			float32x2_t pairMinimum = vpmin_f32(vget_low_f32(minimum), vget_high_f32(minimum));
+			pairMinimum = vpmin_f32(pairMinimum, pairMinimum);
+
+			if (vget_lane_f32(pairMinimum, 0) <= InOutResult.Cost)
+			{
+				vst1q_f32(laneCosts, costLow);
+				vst1q_f32(laneCosts + 4, costHigh);
+				ReduceBlock(laneCosts, BlockIndex * BlockWidth, BeginLane, EndLane, InOutResult);
+			}
+		});
+	}
+#endif //MOTIONMATCHING_WITH_NEON
+
+	template<typename ValueType>
+	void FindLowestCostQuantized(EMotionMatchingCostKernel Kernel, const FMotionFeatureDatabase& Database, const FActiveDimensions& Active, int32 BeginSample, int32 EndSample, FMotionMatchingSearchResult& InOutResult)
+	{
+		switch (Kernel)
+		{
+#if MOTIONMATCHING_WITH_NEON
+		case EMotionMatchingCostKernel::NEON:
+			FindLowestCostQuantizedNEON<ValueType>(Database, Active, BeginSample, EndSample, InOutResult);
+			break;
+#endif
+#if MOTIONMATCHING_WITH_AVX2
+		case EMotionMatchingCostKernel::AVX2:
+			FindLowestCostQuantizedAVX2<ValueType>(Database, Active, BeginSample, EndSample, InOutResult);
+			break;
+#endif
+#if MOTIONMATCHING_WITH_SSE
+		case EMotionMatchingCostKernel::SSE:
+			FindLowestCostQuantizedSSE<ValueType>(Database, Active, BeginSample, EndSample, InOutResult);
+			break;
+#endif
+		default:
+			FindLowestCostQuantizedScalar<ValueType>(Database, Active, BeginSample, EndSample, InOutResult);
+			break;
+		}
+	}
+}
+
+MotionMatchingCostKernel::FActiveDimensions::FActiveDimensions(const float* InQuery, const float* InWeights, int32 NumDimensions)
+{
+	for (int32 dimension = 0; dimension < NumDimensions; ++dimension)
+	{
+		if (InWeights[dimension] != 0.0f)
+		{
+			Dimensions.Add(dimension);
+			Query.Add(InQuery[dimension]);
+			Weights.Add(InWeights[dimension]);
+		}
+	}
+}
+
+EMotionMatchingCostKernel MotionMatchingCostKernel::Resolve(EMotionMatchingCostKernel Kernel)
+{
+#if MOTIONMATCHING_WITH_AVX2
+	static const bool bHasAVX2Support = HasAVX2Support();
+#endif
+
+	switch (Kernel)
+	{
+	case EMotionMatchingCostKernel::Scalar:
+		return EMotionMatchingCostKernel::Scalar;
+#if MOTIONMATCHING_WITH_NEON
+	case EMotionMatchingCostKernel::NEON:
+		return EMotionMatchingCostKernel::NEON;
+#endif
+#if MOTIONMATCHING_WITH_AVX2
+	case EMotionMatchingCostKernel::AVX2:
+		return bHasAVX2Support ? EMotionMatchingCostKernel::AVX2 : EMotionMatchingCostKernel::SSE;
+#endif
+#if MOTIONMATCHING_WITH_SSE
+	case EMotionMatchingCostKernel::SSE:
+		return EMotionMatchingCostKernel::SSE;
+#endif
+	case EMotionMatchingCostKernel::Auto:
+#if MOTIONMATCHING_WITH_NEON
+		return EMotionMatchingCostKernel::NEON;
+#elif MOTIONMATCHING_WITH_AVX2
+		return bHasAVX2Support ? EMotionMatchingCostKernel::AVX2 : EMotionMatchingCostKernel::SSE;
+#elif MOTIONMATCHING_WITH_SSE
+		return EMotionMatchingCostKernel::SSE;
+#endif
+	default:
+		return EMotionMatchingCostKernel::Scalar;
+	}
+}
+
+float MotionMatchingCostKernel::ComputeCost(const float* Features, const float* Query, const float* Weights, int32 NumDimensions)
+{
+	float cost = 0.0f;
+
+	for (int32 dimension = 0; dimension < NumDimensions; ++dimension)
+	{
+		if (Weights[dimension] != 0.0f)
+		{
+			const float difference = Query[dimension] - Features[dimension];
+			float term = difference * difference;
+			term = term * Weights[dimension];
+			cost = cost + term;
+		}
+	}
+
+	return cost;
+}
+
+void MotionMatchingCostKernel::FindLowestCost(EMotionMatchingCostKernel Kernel, const FMotionFeatureDatabase& Database, const float* Query, const float* Weights, int32 BeginSample, int32 EndSample, FMotionMatchingSearchResult& InOutResult)
+{
+	FindLowestCost(Kernel, Database, FActiveDimensions{Query, Weights, Database.GetNumDimensions()}, BeginSample, EndSample, InOutResult);
+}
+
+void MotionMatchingCostKernel::FindLowestCost(EMotionMatchingCostKernel Kernel, const FMotionFeatureDatabase& Database, const FActiveDimensions& Active, int32 BeginSample, int32 EndSample, FMotionMatchingSearchResult& InOutResult)
+{
+	BeginSample = FMath::Max(BeginSample, 0);
+	EndSample = FMath::Min(EndSample, Database.GetNumSamples());
+
+	if (BeginSample >= EndSample)
+	{
+		return;
+	}
+
+	switch (Database.GetQuantization())
+	{
+	case EMotionFeatureQuantization::Int16:
+		FindLowestCostQuantized<int16>(Resolve(Kernel), Database, Active, BeginSample, EndSample, InOutResult);
+		return;
+	case EMotionFeatureQuantization::Int8:
+		FindLowestCostQuantized<int8>(Resolve(Kernel), Database, Active, BeginSample, EndSample, InOutResult);
+		return;
+	default:
+		break;
+	}
+
+	switch (Resolve(Kernel))
+	{
+#if MOTIONMATCHING_WITH_NEON
+	case EMotionMatchingCostKernel::NEON:
+		FindLowestCostNEON(Database, Active, BeginSample, EndSample, InOutResult);
+		break;
+#endif
+#if MOTIONMATCHING_WITH_AVX2
+	case EMotionMatchingCostKernel::AVX2:
+		FindLowestCostAVX2(Database, Active, BeginSample, EndSample, InOutResult);
+		break;
+#endif
+#if MOTIONMATCHING_WITH_SSE
+	case EMotionMatchingCostKernel::SSE:
+		FindLowestCostSSE(Database, Active, BeginSample, EndSample, InOutResult);
+		break;
+#endif
+	default:
+		FindLowestCostScalar(Database, Active, BeginSample, EndSample, InOutResult);
+		break;
+	}
+}
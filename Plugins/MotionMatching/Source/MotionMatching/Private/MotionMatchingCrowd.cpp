@@ -0,0 +1,175 @@
+#include "MotionMatchingCrowd.h"
+#include "MotionMatchingStats.h"
+#include "Algo/Sort.h"
+#include "Async/ParallelFor.h"
+#include "Containers/Ticker.h"
+#include "Misc/ScopeLock.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+
+DEFINE_STAT(STAT_MotionMatchingBatchedQueries);
+
+namespace
+{
+	// Searches backed by an index are answered one by one, everything else goes through the batched scan.
+	bool IsBatchable(const FMotionMatchingSearchRequest& Request)
+	{
+		return Request.Settings.SearchMode == EMotionMatchingSearchMode::BruteForce || !Request.Database->SearchIndex.Supports(Request.Settings.SearchMode);
+	}
+}
+
+void FMotionMatchingSearchRequest::Execute()
+{
+	MotionMatchingSearch::FindLowestCost(Settings, Database->FeatureDatabase, Database->SearchIndex, Query.GetData(), Weights.GetData(), Result, Stats);
+	MarkDone();
+}
+
+bool FMotionMatchingSearchRequest::TryExecute()
+{
+	if (bIsStarted.Exchange(true))
+	{
+		return false;
+	}
+
+	Execute();
+
+	return true;
+}
+
+void FMotionMatchingSearchRequest::Wait() const
+{
+	if (Task.IsValid())
+	{
+		Task.Wait();
+	}
+}
+
+FMotionMatchingCrowd& FMotionMatchingCrowd::Get()
+{
+	static FMotionMatchingCrowd crowd;
+
+	return crowd;
+}
+
+void FMotionMatchingCrowd::Startup()
+{
+	TickerHandle = FTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateRaw(this, &FMotionMatchingCrowd::Tick));
+}
+
+void FMotionMatchingCrowd::Shutdown()
+{
+	FTicker::GetCoreTicker().RemoveTicker(TickerHandle);
+	TickerHandle.Reset();
+
+	FScopeLock scopeLock{&CriticalSection};
+	PendingRequests.Empty();
+}
+
+void FMotionMatchingCrowd::Submit(const FMotionMatchingSearchRequestPtr& Request)
+{
+	if (!Request.IsValid() || !Request->Database.IsValid())
+	{
+		ensureMsgf(false, TEXT("Search request has no database"));
+
+		return;
+	}
+
+	FScopeLock scopeLock{&CriticalSection};
+	PendingRequests.Add(Request);
+}
+
+void FMotionMatchingCrowd::ProcessPendingRequests()
+{
+	{
+		FScopeLock scopeLock{&CriticalSection};
+		Swap(PendingRequests, ProcessedRequests);
+	}
+
+	if (ProcessedRequests.Num() == 0)
+	{
+		return;
+	}
+
+	// Requests sharing a database are grouped so that every tile of it is read once per group:
+	Algo::Sort(ProcessedRequests, [](const FMotionMatchingSearchRequestPtr& Lhs, const FMotionMatchingSearchRequestPtr& Rhs)
+	{
+		return Lhs->Database.Get() < Rhs->Database.Get();
+	});
+
+	TArray<TPair<int32, int32>, TInlineAllocator<64>> groups;
+
+	for (int32 requestIndex = 0; requestIndex < ProcessedRequests.Num(); ++requestIndex)
+	{
+		const FMotionMatchingSearchRequestPtr& request = ProcessedRequests[requestIndex];
+		const bool bCanJoinGroup = groups.Num() > 0
+			&& IsBatchable(*request)
+			&& IsBatchable(*ProcessedRequests[groups.Last().Key])
+			&& ProcessedRequests[groups.Last().Key]->Database == request->Database
+			&& groups.Last().Value - groups.Last().Key < MaxQueriesPerGroup;
+
+		if (bCanJoinGroup)
+		{
+			++groups.Last().Value;
+		}
+		else
+		{
+			groups.Emplace(requestIndex, requestIndex + 1);
+		}
+	}
+
+	ParallelFor(groups.Num(), [this, &groups](int32 GroupIndex)
+	{
+		SCOPE_CYCLE_COUNTER(STAT_MotionMatchingBatchedSearch);
+		TRACE_CPUPROFILER_EVENT_SCOPE(MotionMatchingBatchedSearch);
+
+		const int32 beginRequest = groups[GroupIndex].Key;
+		const int32 endRequest = groups[GroupIndex].Value;
+		const FMotionMatchingSearchRequestPtr& firstRequest = ProcessedRequests[beginRequest];
+
+		if (!IsBatchable(*firstRequest))
+		{
+			firstRequest->Execute();
+
+			return;
+		}
+
+		const FMotionFeatureDatabase& database = firstRequest->Database->FeatureDatabase;
+		const int32 numSamples = database.GetNumSamples();
+		TArray<MotionMatchingCostKernel::FActiveDimensions, TInlineAllocator<MaxQueriesPerGroup>> activeDimensions;
+
+		for (int32 requestIndex = beginRequest; requestIndex < endRequest; ++requestIndex)
+		{
+			const FMotionMatchingSearchRequestPtr& request = ProcessedRequests[requestIndex];
+			activeDimensions.Emplace(request->Query.GetData(), request->Weights.GetData(), database.GetNumDimensions());
+		}
+
+		for (int32 tileBegin = 0; tileBegin < numSamples; tileBegin += TileSize)
+		{
+			const int32 tileEnd = FMath::Min(tileBegin + TileSize, numSamples);
+
+			for (int32 requestIndex = beginRequest; requestIndex < endRequest; ++requestIndex)
+			{
+				const FMotionMatchingSearchRequestPtr& request = ProcessedRequests[requestIndex];
+				MotionMatchingCostKernel::FindLowestCost(request->Settings.CostKernel, database, activeDimensions[requestIndex - beginRequest], tileBegin, tileEnd, request->Result);
+			}
+		}
+
+		for (int32 requestIndex = beginRequest; requestIndex < endRequest; ++requestIndex)
+		{
+			const FMotionMatchingSearchRequestPtr& request = ProcessedRequests[requestIndex];
+			request->Stats.CandidatesEvaluated += numSamples;
+			request->MarkDone();
+		}
+
+		INC_DWORD_STAT_BY(STAT_MotionMatchingCandidatesEvaluated, (endRequest - beginRequest) * numSamples);
+		INC_DWORD_STAT_BY(STAT_MotionMatchingBatchedQueries, endRequest - beginRequest);
+	});
+
+	ProcessedRequests.Reset();
+}
+
+bool FMotionMatchingCrowd::Tick(float DeltaTime)
+{
+	ProcessPendingRequests();
+
+	return true;
+}
@@ -0,0 +1,171 @@
+#include "MotionMatchingRecording.h"
+#include "MotionMatching.h"
+#include "HAL/FileManager.h"
+#include "Serialization/MemoryWriter.h"
+
+namespace
+{
+	constexpr uint32 RecordingMagic = 0x4D4D5243;
+
+	enum ERecordedSearchFlags : uint8
+	{
+		SkippedFlag = 1 << 0,
+		WeightsFlag = 1 << 1
+	};
+
+	void SerializeSearchSettings(FArchive& Ar, FMotionMatchingSearchSettings& Settings)
+	{
+		Ar << Settings.SearchMode << Settings.CostKernel << Settings.CandidateBudget << Settings.ParallelSearchThreshold;
+	}
+
+	void SerializeSearchResult(FArchive& Ar, FMotionMatchingSearchResult& Result)
+	{
+		Ar << Result.SampleIndex << Result.Cost;
+	}
+
+	void SerializeSearch(FArchive& Ar, FMotionMatchingRecordedSearch& Search, TArray<float>& InOutLastWeights)
+	{
+		uint8 flags = 0;
+
+		if (Ar.IsSaving())
+		{
+			flags = (Search.bSkipped ? SkippedFlag : 0) | ((Search.Weights != InOutLastWeights) ? WeightsFlag : 0);
+		}
+
+		Ar << flags << Search.Time << Search.SearchMode;
+		Search.Query.BulkSerialize(Ar);
+
+		if (flags & WeightsFlag)
+		{
+			Search.Weights.BulkSerialize(Ar);
+			InOutLastWeights = Search.Weights;
+		}
+		else if (Ar.IsLoading())
+		{
+			Search.Weights = InOutLastWeights;
+		}
+
+		SerializeSearchResult(Ar, Search.InitialResult);
+		SerializeSearchResult(Ar, Search.Result);
+		Ar << Search.AnimKey << Search.SearchMicroseconds;
+		Search.bSkipped = (flags & SkippedFlag) != 0;
+	}
+}
+
+bool FMotionMatchingRecording::Load(const FString& Path)
+{
+	Database.Reset();
+	Searches.Reset();
+
+	const TUniquePtr<FArchive> reader{IFileManager::Get().CreateFileReader(*Path)};
+
+	if (!reader.IsValid())
+	{
+		UE_LOG(LogMotionMatching, Error, TEXT("Could not open recording %s"), *Path);
+
+		return false;
+	}
+
+	uint32 magic = 0;
+	int32 version = 0;
+	int32 databaseVersion = 0;
+	int64 databaseSize = 0;
+	*reader << magic << version << databaseVersion << databaseSize;
+
+	if (magic != RecordingMagic || version != Version)
+	{
+		UE_LOG(LogMotionMatching, Error, TEXT("%s is not a motion matching recording of version %d"), *Path, Version);
+
+		return false;
+	}
+
+	const int64 databaseEnd = reader->Tell() + databaseSize;
+
+	if (databaseVersion == FMotionDatabase::SerializationVersion)
+	{
+		const TSharedRef<FMotionDatabase, ESPMode::ThreadSafe> database = MakeShared<FMotionDatabase, ESPMode::ThreadSafe>();
+		database->Serialize(*reader);
+
+		if (reader->Tell() == databaseEnd && !reader->IsError())
+		{
+			Database = database;
+		}
+	}
+
+	reader->Seek(databaseEnd);
+	SerializeSearchSettings(*reader, SearchSettings);
+
+	TArray<float> lastWeights;
+
+	while (reader->Tell() < reader->TotalSize() && !reader->IsError())
+	{
+		SerializeSearch(*reader, Searches.AddDefaulted_GetRef(), lastWeights);
+	}
+
+	// A recording cut short, e.g. by a crash, keeps every complete search:
+	if (reader->IsError() && Searches.Num() > 0)
+	{
+		UE_LOG(LogMotionMatching, Warning, TEXT("%s ends in the middle of a search, only the first %d are used"), *Path, Searches.Num() - 1);
+		Searches.Pop();
+	}
+
+	return true;
+}
+
+FMotionMatchingRecorder::~FMotionMatchingRecorder()
+{
+	Close();
+}
+
+bool FMotionMatchingRecorder::Open(const FString& Path, const FMotionDatabase& Database, const FMotionMatchingSearchSettings& SearchSettings)
+{
+	Close();
+	Writer.Reset(IFileManager::Get().CreateFileWriter(*Path));
+
+	if (!Writer.IsValid())
+	{
+		UE_LOG(LogMotionMatching, Error, TEXT("Could not create recording %s"), *Path);
+
+		return false;
+	}
+
+	// The database is staged first so that loading can skip one it cannot read without parsing it:
+	TArray<uint8> databaseData;
+	FMemoryWriter databaseWriter{databaseData, true};
+	const_cast<FMotionDatabase&>(Database).Serialize(databaseWriter);
+
+	uint32 magic = RecordingMagic;
+	int32 version = FMotionMatchingRecording::Version;
+	int32 databaseVersion = FMotionDatabase::SerializationVersion;
+	int64 databaseSize = databaseData.Num();
+	FMotionMatchingSearchSettings searchSettings{SearchSettings};
+
+	*Writer << magic << version << databaseVersion << databaseSize;
+	Writer->Serialize(databaseData.GetData(), databaseSize);
+	SerializeSearchSettings(*Writer, searchSettings);
+	LastWeights.Reset();
+
+	UE_LOG(LogMotionMatching, Log, TEXT("Recording motion matching searches to %s"), *Path);
+
+	return true;
+}
+
+void FMotionMatchingRecorder::Close()
+{
+	if (Writer.IsValid())
+	{
+		Writer->Close();
+		Writer.Reset();
+	}
+}
+
+void FMotionMatchingRecorder::Record(const FMotionMatchingRecordedSearch& Search)
+{
+	if (!Writer.IsValid())
+	{
+		return;
+	}
+
+	// Saving leaves the search untouched, archives just only take mutable references:
+	SerializeSearch(*Writer, const_cast<FMotionMatchingRecordedSearch&>(Search), LastWeights);
+}
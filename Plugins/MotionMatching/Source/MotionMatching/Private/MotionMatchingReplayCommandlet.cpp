@@ -0,0 +1,182 @@
+#include "MotionMatchingReplayCommandlet.h"
+#include "MotionMatching.h"
+#include "MotionMatchingRecording.h"
+#include "MotionDatabaseAsset.h"
+#include "Misc/Parse.h"
+
+namespace
+{
+	// Replayed searches are logged one by one up to this many differences, only counted after.
+	constexpr int32 MaxLoggedDifferences = 20;
+
+	template <typename EnumType>
+	bool ParseEnumValue(const FString& Params, const TCHAR* Match, EnumType& InOutValue)
+	{
+		FString valueName;
+
+		if (!FParse::Value(*Params, Match, valueName))
+		{
+			return false;
+		}
+
+		const int64 value = StaticEnum<EnumType>()->GetValueByNameString(valueName);
+
+		if (value == INDEX_NONE)
+		{
+			UE_LOG(LogMotionMatching, Warning, TEXT("Unknown value %s%s, the recorded one is kept"), Match, *valueName);
+
+			return false;
+		}
+
+		InOutValue = static_cast<EnumType>(value);
+
+		return true;
+	}
+
+	double GetPercentile(TArray<double>& Values, float Percentile)
+	{
+		if (Values.Num() == 0)
+		{
+			return 0.0;
+		}
+
+		Values.Sort();
+
+		return Values[FMath::Min(static_cast<int32>(Percentile * Values.Num()), Values.Num() - 1)];
+	}
+}
+
+UMotionMatchingReplayCommandlet::UMotionMatchingReplayCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = false;
+	LogToConsole = true;
+}
+
+int32 UMotionMatchingReplayCommandlet::Main(const FString& Params)
+{
+	FString recordingPath;
+	FString databasePath;
+	FString outputPath;
+	FParse::Value(*Params, TEXT("Recording="), recordingPath);
+	FParse::Value(*Params, TEXT("Database="), databasePath);
+	FParse::Value(*Params, TEXT("Output="), outputPath);
+
+	FMotionMatchingRecording recording;
+
+	if (recordingPath.IsEmpty() || !recording.Load(recordingPath))
+	{
+		UE_LOG(LogMotionMatching, Error, TEXT("Replay needs a readable -Recording=<file>"));
+
+		return 1;
+	}
+
+	FMotionDatabasePtr database = recording.Database;
+
+	if (!databasePath.IsEmpty())
+	{
+		const UMotionDatabaseAsset* asset = LoadObject<UMotionDatabaseAsset>(nullptr, *databasePath);
+		database = asset ? asset->GetDatabase() : nullptr;
+	}
+
+	if (!database.IsValid())
+	{
+		UE_LOG(LogMotionMatching, Error, TEXT("%s has no database this build can read, pass one with -Database=<asset path>"), *recordingPath);
+
+		return 1;
+	}
+
+	FMotionMatchingSearchSettings searchSettings = recording.SearchSettings;
+	const bool bOverrideSearchMode = ParseEnumValue(Params, TEXT("SearchMode="), searchSettings.SearchMode);
+	ParseEnumValue(Params, TEXT("CostKernel="), searchSettings.CostKernel);
+	FParse::Value(*Params, TEXT("Budget="), searchSettings.CandidateBudget);
+
+	FMotionMatchingRecorder outputRecorder;
+
+	if (!outputPath.IsEmpty())
+	{
+		outputRecorder.Open(outputPath, *database, searchSettings);
+	}
+
+	const FMotionFeatureDatabase& featureDatabase = database->FeatureDatabase;
+	TArray<double> recordedMicroseconds;
+	TArray<double> replayedMicroseconds;
+	int32 numSkipped = 0;
+	int32 numDifferences = 0;
+	float maxCostDifference = 0.0f;
+
+	for (int32 searchIndex = 0; searchIndex < recording.Searches.Num(); ++searchIndex)
+	{
+		const FMotionMatchingRecordedSearch& recordedSearch = recording.Searches[searchIndex];
+
+		if (recordedSearch.Query.Num() != featureDatabase.GetNumDimensions() || recordedSearch.Weights.Num() != featureDatabase.GetNumDimensions())
+		{
+			UE_LOG(LogMotionMatching, Error, TEXT("Search %d has %d dimensions, the database %d"), searchIndex, recordedSearch.Query.Num(), featureDatabase.GetNumDimensions());
+
+			return 1;
+		}
+
+		FMotionMatchingRecordedSearch replayedSearch{recordedSearch};
+
+		// Skipped searches only scored the continuation, which has to cost the same again:
+		if (recordedSearch.bSkipped)
+		{
+			++numSkipped;
+
+			if (featureDatabase.IsValidSampleIndex(recordedSearch.Result.SampleIndex))
+			{
+				replayedSearch.Result.Cost = MotionMatchingCostKernel::ComputeCost(featureDatabase.GetFeatures(recordedSearch.Result.SampleIndex), recordedSearch.Query.GetData(), recordedSearch.Weights.GetData(), featureDatabase.GetNumDimensions());
+			}
+		}
+		else
+		{
+			FMotionMatchingSearchStats searchStats;
+			replayedSearch.Result = recordedSearch.InitialResult;
+			replayedSearch.SearchMode = bOverrideSearchMode ? searchSettings.SearchMode : recordedSearch.SearchMode;
+			searchSettings.SearchMode = replayedSearch.SearchMode;
+
+			const uint64 startCycles = FPlatformTime::Cycles64();
+			MotionMatchingSearch::FindLowestCost(searchSettings, featureDatabase, database->SearchIndex, recordedSearch.Query.GetData(), recordedSearch.Weights.GetData(), replayedSearch.Result, searchStats);
+			replayedSearch.SearchMicroseconds = FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - startCycles) * 1000.0;
+
+			replayedMicroseconds.Add(replayedSearch.SearchMicroseconds);
+
+			if (recordedSearch.SearchMicroseconds > 0.0f)
+			{
+				recordedMicroseconds.Add(recordedSearch.SearchMicroseconds);
+			}
+		}
+
+		replayedSearch.AnimKey = featureDatabase.IsValidSampleIndex(replayedSearch.Result.SampleIndex) ? featureDatabase.GetAnimKey(replayedSearch.Result.SampleIndex) : FAnimKey{};
+		outputRecorder.Record(replayedSearch);
+
+		const float costDifference = FMath::Abs(replayedSearch.Result.Cost - recordedSearch.Result.Cost);
+		maxCostDifference = FMath::Max(maxCostDifference, costDifference);
+
+		if (replayedSearch.Result.SampleIndex == recordedSearch.Result.SampleIndex && replayedSearch.AnimKey == recordedSearch.AnimKey && costDifference == 0.0f)
+		{
+			continue;
+		}
+
+		if (numDifferences < MaxLoggedDifferences)
+		{
+			UE_LOG(LogMotionMatching, Display, TEXT("Search %d at %.3fs: recorded sample %d (clip %d at %.3fs, cost %f), replayed sample %d (clip %d at %.3fs, cost %f)"),
+				searchIndex, recordedSearch.Time,
+				recordedSearch.Result.SampleIndex, recordedSearch.AnimKey.Index, recordedSearch.AnimKey.StartTime, recordedSearch.Result.Cost,
+				replayedSearch.Result.SampleIndex, replayedSearch.AnimKey.Index, replayedSearch.AnimKey.StartTime, replayedSearch.Result.Cost);
+		}
+
+		++numDifferences;
+	}
+
+	outputRecorder.Close();
+
+	UE_LOG(LogMotionMatching, Display, TEXT("Replayed %d searches (%d skipped): %d differ, largest cost difference %f"),
+		recording.Searches.Num(), numSkipped, numDifferences, maxCostDifference);
+	UE_LOG(LogMotionMatching, Display, TEXT("Search time p50/p99: recorded %.1f/%.1f us over %d searches, replayed %.1f/%.1f us"),
+		GetPercentile(recordedMicroseconds, 0.5f), GetPercentile(recordedMicroseconds, 0.99f), recordedMicroseconds.Num(),
+		GetPercentile(replayedMicroseconds, 0.5f), GetPercentile(replayedMicroseconds, 0.99f));
+
+	return numDifferences > 0 ? 1 : 0;
+}
@@ -0,0 +1,165 @@
+#include "MotionMatchingSearch.h"
+#include "MotionFeatureDatabase.h"
+#include "MotionMatchingStats.h"
+#include "Async/ParallelFor.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+
+DEFINE_STAT(STAT_MotionMatchingCandidatesEvaluated);
+DEFINE_STAT(STAT_MotionMatchingCandidatesPruned);
+DEFINE_STAT(STAT_MotionMatchingPrunedFraction);
+DEFINE_STAT(STAT_MotionMatchingSkippedSearches);
+
+namespace
+{
+	// Chunks smaller than this cost more to schedule than to scan.
+	constexpr int32 MinSamplesPerChunk = 1024;
+
+	EMotionMatchingSearchMode ResolveSearchMode(EMotionMatchingSearchMode SearchMode, const FMotionMatchingSearchIndex& SearchIndex)
+	{
+		return SearchIndex.Supports(SearchMode) ? SearchMode : EMotionMatchingSearchMode::BruteForce;
+	}
+
+	void FindLowestCostInParallel(EMotionMatchingCostKernel CostKernel, const FMotionFeatureDatabase& Database, const float* Query, const float* Weights, FMotionMatchingSearchResult& InOutResult)
+	{
+		const int32 numSamples = Database.GetNumSamples();
+		const int32 maxChunks = FMath::Max(FMath::DivideAndRoundDown(numSamples, MinSamplesPerChunk), 1);
+		const int32 numChunks = FMath::Min(FTaskGraphInterface::Get().GetNumWorkerThreads() + 1, maxChunks);
+		// Chunk boundaries fall on block boundaries so that every chunk scans whole blocks:
+		const int32 chunkSize = Align(FMath::DivideAndRoundUp(numSamples, numChunks), FMotionFeatureDatabase::BlockWidth);
+
+		TArray<FMotionMatchingSearchResult, TInlineAllocator<32>> chunkResults;
+		chunkResults.Init(InOutResult, numChunks);
+
+		ParallelFor(numChunks, [&](int32 ChunkIndex)
+		{
+			const int32 beginSample = ChunkIndex * chunkSize;
+			const int32 endSample = FMath::Min(beginSample + chunkSize, numSamples);
+
+			if (beginSample < endSample)
+			{
+				MotionMatchingCostKernel::FindLowestCost(CostKernel, Database, Query, Weights, beginSample, endSample, chunkResults[ChunkIndex]);
+			}
+		}, numChunks == 1);
+
+		// Ties go to the lowest sample index, so the result does not depend on which chunk finished first:
+		for (const FMotionMatchingSearchResult& chunkResult : chunkResults)
+		{
+			if (chunkResult.Cost < InOutResult.Cost || (chunkResult.Cost == InOutResult.Cost && chunkResult.SampleIndex < InOutResult.SampleIndex))
+			{
+				InOutResult = chunkResult;
+			}
+		}
+	}
+}
+
+void FMotionMatchingSearchIndex::Build(const FMotionFeatureDatabase& Database, const float* Weights, const TArray<EMotionMatchingSearchMode>& SearchModes)
+{
+	Reset();
+
+	if (SearchModes.Contains(EMotionMatchingSearchMode::KDTree))
+	{
+		KDTree.Build(Database, Weights);
+	}
+
+	if (SearchModes.Contains(EMotionMatchingSearchMode::AABBTree))
+	{
+		AABBTree.Build(Database);
+	}
+
+	if (SearchModes.Contains(EMotionMatchingSearchMode::Approximate))
+	{
+		HNSW.Build(Database, Weights);
+	}
+}
+
+void FMotionMatchingSearchIndex::Reset()
+{
+	KDTree.Reset();
+	AABBTree.Reset();
+	HNSW.Reset();
+}
+
+void FMotionMatchingSearchIndex::Serialize(FArchive& Ar)
+{
+	KDTree.Serialize(Ar);
+	AABBTree.Serialize(Ar);
+	HNSW.Serialize(Ar);
+}
+
+SIZE_T FMotionMatchingSearchIndex::GetAllocatedSize() const
+{
+	return KDTree.GetAllocatedSize() + AABBTree.GetAllocatedSize() + HNSW.GetAllocatedSize();
+}
+
+bool FMotionMatchingSearchIndex::Supports(EMotionMatchingSearchMode SearchMode) const
+{
+	switch (SearchMode)
+	{
+	case EMotionMatchingSearchMode::KDTree:
+		return KDTree.IsBuilt();
+	case EMotionMatchingSearchMode::AABBTree:
+		return AABBTree.IsBuilt();
+	case EMotionMatchingSearchMode::Approximate:
+		return HNSW.IsBuilt();
+	default:
+		return true;
+	}
+}
+
+void MotionMatchingSearch::FindLowestCost(const FMotionMatchingSearchSettings& Settings, const FMotionFeatureDatabase& Database, const FMotionMatchingSearchIndex& SearchIndex, const float* Query, const float* Weights, FMotionMatchingSearchResult& InOutResult, FMotionMatchingSearchStats& OutStats)
+{
+	SCOPE_CYCLE_COUNTER(STAT_MotionMatchingSearch);
+	TRACE_CPUPROFILER_EVENT_SCOPE(MotionMatchingSearch);
+
+	FMotionMatchingSearchStats searchStats;
+
+	switch (ResolveSearchMode(Settings.SearchMode, SearchIndex))
+	{
+	case EMotionMatchingSearchMode::KDTree:
+		SearchIndex.KDTree.FindLowestCost(Database, Query, Weights, InOutResult, searchStats);
+		break;
+	case EMotionMatchingSearchMode::AABBTree:
+		SearchIndex.AABBTree.FindLowestCost(Settings.CostKernel, Database, Query, Weights, InOutResult, searchStats);
+		break;
+	case EMotionMatchingSearchMode::Approximate:
+		SearchIndex.HNSW.FindLowestCost(Database, Query, Weights, Settings.CandidateBudget, InOutResult, searchStats);
+		break;
+	default:
+		if (Settings.ParallelSearchThreshold > 0 && Database.GetNumSamples() >= Settings.ParallelSearchThreshold)
+		{
+			FindLowestCostInParallel(Settings.CostKernel, Database, Query, Weights, InOutResult);
+		}
+		else
+		{
+			MotionMatchingCostKernel::FindLowestCost(Settings.CostKernel, Database, Query, Weights, 0, Database.GetNumSamples(), InOutResult);
+		}
+
+		searchStats.CandidatesEvaluated = Database.GetNumSamples();
+		break;
+	}
+
+	INC_DWORD_STAT_BY(STAT_MotionMatchingCandidatesEvaluated, searchStats.CandidatesEvaluated);
+	INC_DWORD_STAT_BY(STAT_MotionMatchingCandidatesPruned, searchStats.CandidatesPruned);
+	SET_FLOAT_STAT(STAT_MotionMatchingPrunedFraction, searchStats.GetPrunedFraction());
+
+	OutStats.CandidatesEvaluated += searchStats.CandidatesEvaluated;
+	OutStats.CandidatesPruned += searchStats.CandidatesPruned;
+}
+
+float MotionMatchingSearch::ComputeSampleCost(const FMotionMatchingSearchSettings& Settings, const FMotionFeatureDatabase& Database, const FMotionMatchingSearchIndex& SearchIndex, int32 SampleIndex, const float* Query, const float* Weights)
+{
+	switch (ResolveSearchMode(Settings.SearchMode, SearchIndex))
+	{
+	case EMotionMatchingSearchMode::KDTree:
+	case EMotionMatchingSearchMode::Approximate:
+		return MotionMatchingCostKernel::ComputeCost(Database.GetFeatures(SampleIndex), Query, Weights, Database.GetNumDimensions());
+	default:
+	{
+		// A scan of just this sample, so that its cost compares with the ones of a scan over the whole database:
+		FMotionMatchingSearchResult result;
+		MotionMatchingCostKernel::FindLowestCost(Settings.CostKernel, Database, Query, Weights, SampleIndex, SampleIndex + 1, result);
+
+		return result.Cost;
+	}
+	}
+}
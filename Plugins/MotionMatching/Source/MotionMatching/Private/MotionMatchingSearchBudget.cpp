@@ -0,0 +1,45 @@
+#include "MotionMatchingSearchBudget.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/ScopeLock.h"
+
+namespace
+{
+	TAutoConsoleVariable<int32> CVarMotionMatchingMaxSearchesPerFrame(
+		TEXT("MotionMatching.MaxSearchesPerFrame"),
+		0,
+		TEXT("Most motion matching searches started in one frame over all characters, 0 for no limit."));
+}
+
+FMotionMatchingSearchBudget& FMotionMatchingSearchBudget::Get()
+{
+	static FMotionMatchingSearchBudget budget;
+
+	return budget;
+}
+
+bool FMotionMatchingSearchBudget::TryAcquire()
+{
+	const int32 maxSearchesPerFrame = CVarMotionMatchingMaxSearchesPerFrame.GetValueOnAnyThread();
+
+	if (maxSearchesPerFrame <= 0)
+	{
+		return true;
+	}
+
+	FScopeLock scopeLock{&CriticalSection};
+
+	if (Frame != GFrameCounter)
+	{
+		Frame = GFrameCounter;
+		NumAcquired = 0;
+	}
+
+	if (NumAcquired >= maxSearchesPerFrame)
+	{
+		return false;
+	}
+
+	++NumAcquired;
+
+	return true;
+}
@@ -0,0 +1,130 @@
+#include "MotionMatchingStats.h"
+#include "Trace/Trace.h"
+
+DEFINE_STAT(STAT_MotionMatchingSearch);
+DEFINE_STAT(STAT_MotionMatchingBatchedSearch);
+DEFINE_STAT(STAT_MotionMatchingPoseEvaluation);
+DEFINE_STAT(STAT_MotionMatchingRootMotion);
+DEFINE_STAT(STAT_MotionMatchingDatabaseBuild);
+DEFINE_STAT(STAT_MotionMatchingDatabaseMemory);
+DEFINE_STAT(STAT_MotionMatchingSearches);
+DEFINE_STAT(STAT_MotionMatchingDeferredSearches);
+DEFINE_STAT(STAT_MotionMatchingMatchSwitches);
+DEFINE_STAT(STAT_MotionMatchingBestCost0);
+DEFINE_STAT(STAT_MotionMatchingBestCost1);
+DEFINE_STAT(STAT_MotionMatchingBestCost2);
+DEFINE_STAT(STAT_MotionMatchingBestCost3);
+DEFINE_STAT(STAT_MotionMatchingBestCost4);
+DEFINE_STAT(STAT_MotionMatchingBestCost5);
+
+// One event per search decision of a node, Node tells the nodes apart:
+UE_TRACE_EVENT_BEGIN(MotionMatching, Search)
+	UE_TRACE_EVENT_FIELD(uint64, Cycle)
+	UE_TRACE_EVENT_FIELD(uint64, Node)
+	UE_TRACE_EVENT_FIELD(int32, SampleIndex)
+	UE_TRACE_EVENT_FIELD(float, Cost)
+	UE_TRACE_EVENT_FIELD(int32, CandidatesEvaluated)
+	UE_TRACE_EVENT_FIELD(int32, CandidatesPruned)
+	UE_TRACE_EVENT_FIELD(bool, Skipped)
+UE_TRACE_EVENT_END()
+
+UE_TRACE_EVENT_BEGIN(MotionMatching, MatchSwitch)
+	UE_TRACE_EVENT_FIELD(uint64, Cycle)
+	UE_TRACE_EVENT_FIELD(uint64, Node)
+UE_TRACE_EVENT_END()
+
+int32 FMotionMatchingNodeCounters::GetCostBucket(float Cost)
+{
+	int32 bucket = 0;
+
+	for (float bucketEnd = 0.5f; bucket < NumCostBuckets - 1 && Cost >= bucketEnd; bucketEnd *= 2.0f)
+	{
+		++bucket;
+	}
+
+	return bucket;
+}
+
+void FMotionMatchingNodeCounters::RecordSearch(const FMotionMatchingSearchResult& Result, const FMotionMatchingSearchStats& Stats)
+{
+	const int32 costBucket = GetCostBucket(Result.Cost);
+
+	++NumSearches;
+	++WindowSearches;
+	CandidatesEvaluated += Stats.CandidatesEvaluated;
+	CandidatesPruned += Stats.CandidatesPruned;
+	LastBestCost = Result.Cost;
+	++BestCostHistogram[costBucket];
+
+#if STATS
+	static const FName costBucketStats[NumCostBuckets] =
+	{
+		GET_STATFNAME(STAT_MotionMatchingBestCost0),
+		GET_STATFNAME(STAT_MotionMatchingBestCost1),
+		GET_STATFNAME(STAT_MotionMatchingBestCost2),
+		GET_STATFNAME(STAT_MotionMatchingBestCost3),
+		GET_STATFNAME(STAT_MotionMatchingBestCost4),
+		GET_STATFNAME(STAT_MotionMatchingBestCost5)
+	};
+
+	INC_DWORD_STAT(STAT_MotionMatchingSearches);
+	INC_DWORD_STAT_FNAME_BY(costBucketStats[costBucket], 1);
+#endif
+
+	UE_TRACE_LOG(MotionMatching, Search)
+		<< Search.Cycle(FPlatformTime::Cycles64())
+		<< Search.Node(reinterpret_cast<UPTRINT>(this))
+		<< Search.SampleIndex(Result.SampleIndex)
+		<< Search.Cost(Result.Cost)
+		<< Search.CandidatesEvaluated(Stats.CandidatesEvaluated)
+		<< Search.CandidatesPruned(Stats.CandidatesPruned)
+		<< Search.Skipped(false);
+}
+
+void FMotionMatchingNodeCounters::RecordSkippedSearch()
+{
+	++NumSkippedSearches;
+	INC_DWORD_STAT(STAT_MotionMatchingSkippedSearches);
+
+	UE_TRACE_LOG(MotionMatching, Search)
+		<< Search.Cycle(FPlatformTime::Cycles64())
+		<< Search.Node(reinterpret_cast<UPTRINT>(this))
+		<< Search.SampleIndex(INDEX_NONE)
+		<< Search.Cost(0.0f)
+		<< Search.CandidatesEvaluated(0)
+		<< Search.CandidatesPruned(0)
+		<< Search.Skipped(true);
+}
+
+void FMotionMatchingNodeCounters::RecordDeferredSearch()
+{
+	++NumDeferredSearches;
+	INC_DWORD_STAT(STAT_MotionMatchingDeferredSearches);
+}
+
+void FMotionMatchingNodeCounters::RecordMatchSwitch()
+{
+	++NumMatchSwitches;
+	INC_DWORD_STAT(STAT_MotionMatchingMatchSwitches);
+
+	UE_TRACE_LOG(MotionMatching, MatchSwitch)
+		<< MatchSwitch.Cycle(FPlatformTime::Cycles64())
+		<< MatchSwitch.Node(reinterpret_cast<UPTRINT>(this));
+}
+
+void FMotionMatchingNodeCounters::Tick(float DeltaTime)
+{
+	WindowTime += DeltaTime;
+
+	if (WindowTime >= 1.0f)
+	{
+		SearchesPerSecond = WindowSearches / WindowTime;
+		WindowSearches = 0;
+		WindowTime = 0.0f;
+	}
+}
+
+void FMotionMatchingNodeCounters::Reset()
+{
+	*this = FMotionMatchingNodeCounters{};
+}
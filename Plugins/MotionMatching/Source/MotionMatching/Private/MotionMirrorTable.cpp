@@ -0,0 +1,165 @@
+#include "MotionMirrorTable.h"
+#include "MotionMatching.h"
+#include "ReferenceSkeleton.h"
+#include "Misc/MemStack.h"
+
+void FMotionMirrorTable::Build(const FReferenceSkeleton& InRefSkeleton, const TArray<FMotionMirrorBonePair>& InBonePairs, EAxis::Type InAxis)
+{
+	Reset();
+
+	if (InAxis == EAxis::None)
+	{
+		return;
+	}
+
+	Axis = InAxis;
+	const int32 numBones = InRefSkeleton.GetNum();
+	MirroredBoneIndices.SetNumUninitialized(numBones);
+
+	for (int32 boneIndex = 0; boneIndex < numBones; ++boneIndex)
+	{
+		MirroredBoneIndices[boneIndex] = boneIndex;
+	}
+
+	for (const FMotionMirrorBonePair& bonePair : InBonePairs)
+	{
+		const int32 boneIndex = InRefSkeleton.FindBoneIndex(bonePair.BoneName);
+		const int32 mirroredBoneIndex = InRefSkeleton.FindBoneIndex(bonePair.MirroredBoneName);
+
+		if (boneIndex == INDEX_NONE || mirroredBoneIndex == INDEX_NONE)
+		{
+			UE_LOG(LogMotionMatching, Warning, TEXT("Mirror pair %s - %s is not part of the skeleton, both bones mirror onto themselves"), *bonePair.BoneName.ToString(), *bonePair.MirroredBoneName.ToString());
+
+			continue;
+		}
+
+		MirroredBoneIndices[boneIndex] = mirroredBoneIndex;
+		MirroredBoneIndices[mirroredBoneIndex] = boneIndex;
+	}
+
+	// Reference rotations in component space, parents always come before their children:
+	const TArray<FTransform>& refBonePose = InRefSkeleton.GetRefBonePose();
+	TArray<FQuat> componentRotations;
+	componentRotations.SetNumUninitialized(numBones);
+
+	for (int32 boneIndex = 0; boneIndex < numBones; ++boneIndex)
+	{
+		const int32 parentIndex = InRefSkeleton.GetParentIndex(boneIndex);
+		componentRotations[boneIndex] = (parentIndex == INDEX_NONE) ? refBonePose[boneIndex].GetRotation() : componentRotations[parentIndex] * refBonePose[boneIndex].GetRotation();
+	}
+
+	RotationCorrections.SetNumUninitialized(numBones);
+
+	for (int32 boneIndex = 0; boneIndex < numBones; ++boneIndex)
+	{
+		const FQuat& mirroredRotation = MirrorRotation(componentRotations[MirroredBoneIndices[boneIndex]]);
+		RotationCorrections[boneIndex] = (mirroredRotation.Inverse() * componentRotations[boneIndex]).GetNormalized();
+	}
+}
+
+void FMotionMirrorTable::Reset()
+{
+	MirroredBoneIndices.Reset();
+	RotationCorrections.Reset();
+	Axis = EAxis::None;
+}
+
+void FMotionMirrorTable::Serialize(FArchive& Ar)
+{
+	Ar << Axis;
+	MirroredBoneIndices.BulkSerialize(Ar);
+	Ar << RotationCorrections;
+}
+
+SIZE_T FMotionMirrorTable::GetAllocatedSize() const
+{
+	return MirroredBoneIndices.GetAllocatedSize() + RotationCorrections.GetAllocatedSize();
+}
+
+FVector FMotionMirrorTable::MirrorVector(const FVector& Vector) const
+{
+	switch (Axis)
+	{
+	case EAxis::X:
+		return FVector{-Vector.X, Vector.Y, Vector.Z};
+	case EAxis::Y:
+		return FVector{Vector.X, -Vector.Y, Vector.Z};
+	case EAxis::Z:
+		return FVector{Vector.X, Vector.Y, -Vector.Z};
+	default:
+		return Vector;
+	}
+}
+
+FQuat FMotionMirrorTable::MirrorRotation(const FQuat& Rotation) const
+{
+	// The rotation axis is a pseudovector, it keeps its component along the mirror axis and flips the others:
+	switch (Axis)
+	{
+	case EAxis::X:
+		return FQuat{Rotation.X, -Rotation.Y, -Rotation.Z, Rotation.W};
+	case EAxis::Y:
+		return FQuat{-Rotation.X, Rotation.Y, -Rotation.Z, Rotation.W};
+	case EAxis::Z:
+		return FQuat{-Rotation.X, -Rotation.Y, Rotation.Z, Rotation.W};
+	default:
+		return Rotation;
+	}
+}
+
+FTransform FMotionMirrorTable::MirrorTransform(const FTransform& Transform) const
+{
+	return FTransform{MirrorRotation(Transform.GetRotation()), MirrorVector(Transform.GetTranslation()), Transform.GetScale3D()};
+}
+
+void FMotionMirrorTable::MirrorPose(FCompactPose& Pose) const
+{
+	if (!IsEnabled())
+	{
+		return;
+	}
+
+	const FBoneContainer& boneContainer = Pose.GetBoneContainer();
+	const int32 numBones = Pose.GetNumBones();
+
+	FMemMark mark{FMemStack::Get()};
+	TArray<FTransform, TMemStackAllocator<>> componentTransforms;
+	TArray<FTransform, TMemStackAllocator<>> mirroredTransforms;
+	componentTransforms.SetNumUninitialized(numBones);
+	mirroredTransforms.SetNumUninitialized(numBones);
+
+	for (const FCompactPoseBoneIndex boneIndex : Pose.ForEachBoneIndex())
+	{
+		const FCompactPoseBoneIndex parentIndex = Pose.GetParentBoneIndex(boneIndex);
+		componentTransforms[boneIndex.GetInt()] = (parentIndex.GetInt() == INDEX_NONE) ? Pose[boneIndex] : Pose[boneIndex] * componentTransforms[parentIndex.GetInt()];
+	}
+
+	// Every bone takes the mirrored transform of its counterpart, which falls back to itself when the counterpart is
+	// not required (e.g. at a lower LOD):
+	for (const FCompactPoseBoneIndex boneIndex : Pose.ForEachBoneIndex())
+	{
+		const int32 skeletonIndex = boneContainer.GetSkeletonIndex(boneIndex);
+		FCompactPoseBoneIndex sourceIndex = boneContainer.GetCompactPoseIndexFromSkeletonIndex(GetMirroredBoneIndex(skeletonIndex));
+
+		if (sourceIndex.GetInt() == INDEX_NONE)
+		{
+			sourceIndex = boneIndex;
+		}
+
+		const FTransform& sourceTransform = componentTransforms[sourceIndex.GetInt()];
+		const FQuat& correction = RotationCorrections.IsValidIndex(skeletonIndex) ? RotationCorrections[skeletonIndex] : FQuat::Identity;
+
+		FTransform& mirroredTransform = mirroredTransforms[boneIndex.GetInt()];
+		mirroredTransform.SetRotation((MirrorRotation(sourceTransform.GetRotation()) * correction).GetNormalized());
+		mirroredTransform.SetTranslation(MirrorVector(sourceTransform.GetTranslation()));
+		mirroredTransform.SetScale3D(sourceTransform.GetScale3D());
+	}
+
+	for (const FCompactPoseBoneIndex boneIndex : Pose.ForEachBoneIndex())
+	{
+		const FCompactPoseBoneIndex parentIndex = Pose.GetParentBoneIndex(boneIndex);
+		const FTransform& mirroredTransform = mirroredTransforms[boneIndex.GetInt()];
+
+		Pose[boneIndex] = (parentIndex.GetInt() == INDEX_NONE) ? mirroredTransform : mirroredTransform.GetRelativeTransform(mirroredTransforms[parentIndex.GetInt()]);
+	}
+}
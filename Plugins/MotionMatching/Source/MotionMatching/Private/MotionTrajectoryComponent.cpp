@@ -0,0 +1,121 @@
+#include "MotionTrajectoryComponent.h"
+#include "GameFramework/Pawn.h"
+
+namespace
+{
+	// Half of the damping that halves the gap every HalfLife, which makes the spring critically damped:
+	float HalfLifeToDamping(float HalfLife)
+	{
+		return 2.0f * 0.69314718f / FMath::Max(HalfLife, KINDA_SMALL_NUMBER);
+	}
+
+	float GetActorYaw(const AActor& Actor)
+	{
+		return FMath::DegreesToRadians(Actor.GetActorRotation().Yaw);
+	}
+}
+
+UMotionTrajectoryComponent::UMotionTrajectoryComponent()
+{
+	PrimaryComponentTick.bCanEverTick = true;
+}
+
+void UMotionTrajectoryComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	if (const AActor* owner = GetOwner())
+	{
+		Yaw = GetActorYaw(*owner);
+		DesiredYaw = Yaw;
+	}
+}
+
+void UMotionTrajectoryComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	const APawn* pawn = Cast<APawn>(GetOwner());
+
+	if (!pawn || DeltaTime <= 0.0f)
+	{
+		return;
+	}
+
+	const FVector& input = pawn->GetLastMovementInputVector().GetClampedToMaxSize(1.0f);
+	DesiredVelocity = FVector{input.X, input.Y, 0.0f} * MaxSpeed;
+
+	// The velocity spring is advanced to keep its acceleration, then snapped to what the character actually does, so
+	// that predictions never drift away from it:
+	const float velocityDamping = HalfLifeToDamping(VelocityHalfLife);
+	const FVector j0 = Velocity - DesiredVelocity;
+	const FVector j1 = Acceleration + j0 * velocityDamping;
+	const float velocityDecay = FMath::Exp(-velocityDamping * DeltaTime);
+	Acceleration = (Acceleration - j1 * velocityDamping * DeltaTime) * velocityDecay;
+
+	const FVector& actualVelocity = pawn->GetVelocity();
+	Velocity = FVector{actualVelocity.X, actualVelocity.Y, 0.0f};
+
+	Yaw = GetActorYaw(*pawn);
+
+	if (FaceControlRotation)
+	{
+		DesiredYaw = FMath::DegreesToRadians(pawn->GetControlRotation().Yaw);
+	}
+	else if (!DesiredVelocity.IsNearlyZero())
+	{
+		DesiredYaw = FMath::Atan2(DesiredVelocity.Y, DesiredVelocity.X);
+	}
+	else
+	{
+		DesiredYaw = Yaw;
+	}
+
+	const float facingDamping = HalfLifeToDamping(FacingHalfLife);
+	const float yawOffset = FMath::FindDeltaAngleRadians(DesiredYaw, Yaw);
+	const float yawJ1 = YawVelocity + yawOffset * facingDamping;
+	YawVelocity = (YawVelocity - yawJ1 * facingDamping * DeltaTime) * FMath::Exp(-facingDamping * DeltaTime);
+}
+
+void UMotionTrajectoryComponent::GetTrajectory(const TArray<float>& Times, const FTransform& Space, TArray<FMotionTrajectoryPoint>& OutPoints) const
+{
+	OutPoints.SetNum(Times.Num(), false);
+
+	const AActor* owner = GetOwner();
+
+	if (!owner)
+	{
+		return;
+	}
+
+	const FVector& location = owner->GetActorLocation();
+
+	for (int32 pointIndex = 0; pointIndex < Times.Num(); ++pointIndex)
+	{
+		const float time = FMath::Max(Times[pointIndex], 0.0f);
+		const float yaw = PredictYaw(time);
+		OutPoints[pointIndex].Position = Space.InverseTransformPosition(location + PredictPosition(time));
+		OutPoints[pointIndex].Facing = Space.InverseTransformVectorNoScale(FVector{FMath::Cos(yaw), FMath::Sin(yaw), 0.0f});
+	}
+}
+
+FVector UMotionTrajectoryComponent::PredictPosition(float Time) const
+{
+	// Closed form of the critically damped velocity spring, integrated over Time:
+	const float damping = HalfLifeToDamping(VelocityHalfLife);
+	const FVector j0 = Velocity - DesiredVelocity;
+	const FVector j1 = Acceleration + j0 * damping;
+	const float decay = FMath::Exp(-damping * Time);
+
+	return (-j1 / FMath::Square(damping) + (-j0 - j1 * Time) / damping) * decay
+		+ j1 / FMath::Square(damping) + j0 / damping + DesiredVelocity * Time;
+}
+
+float UMotionTrajectoryComponent::PredictYaw(float Time) const
+{
+	const float damping = HalfLifeToDamping(FacingHalfLife);
+	const float yawOffset = FMath::FindDeltaAngleRadians(DesiredYaw, Yaw);
+	const float j1 = YawVelocity + yawOffset * damping;
+
+	return DesiredYaw + (yawOffset + j1 * Time) * FMath::Exp(-damping * Time);
+}
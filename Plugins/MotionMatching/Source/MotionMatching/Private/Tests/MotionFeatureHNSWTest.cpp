@@ -0,0 +1,48 @@
+#include "MotionDatabase.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+	constexpr int32 NumTestAnimations = 20;
+	constexpr int32 NumTestSamplesPerAnimation = 250;
+	constexpr int32 NumTestQueries = 200;
+	constexpr int32 TestCandidateBudget = 32;
+	// The synthetic rows reach close to 100% with TestCandidateBudget, the margin keeps the test from failing on small
+	// changes to the graph construction:
+	constexpr float MinRecall = 0.9f;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMotionFeatureHNSWRecallTest, "MotionMatching.Search.ApproximateRecall", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FMotionFeatureHNSWRecallTest::RunTest(const FString& Parameters)
+{
+	FMotionDatabaseSettings settings;
+	settings.BoneNames = TArray<FName>{TEXT("foot_l"), TEXT("foot_r"), TEXT("hand_l"), TEXT("hand_r")};
+	settings.AnimationSampling = 1.0f / 30.0f;
+	settings.TrajectoryTimes = TArray<float>{-0.2f, 0.2f, 0.4f, 0.6f};
+	settings.SearchMode = EMotionMatchingSearchMode::Approximate;
+
+	TArray<float> features;
+	TArray<int32> animationNumSamples;
+	FMotionFeatureDatabase::GenerateSyntheticFeatures(NumTestAnimations * NumTestSamplesPerAnimation, NumTestAnimations, settings.BoneNames.Num(), settings.AnimationSampling, settings.TrajectoryTimes, 0x4D4D, features, animationNumSamples);
+
+	FMotionDatabase database;
+	database.BuildFromFeatures(settings, features, animationNumSamples);
+
+	TArray<float> weights;
+	database.FeatureDatabase.ExpandWeights(settings.IndexWeights, weights);
+
+	if (!TestTrue(TEXT("Approximate search index is built"), database.SearchIndex.HNSW.IsBuilt()))
+	{
+		return false;
+	}
+
+	const float recall = database.SearchIndex.HNSW.MeasureRecall(database.FeatureDatabase, weights.GetData(), TestCandidateBudget, NumTestQueries);
+	AddInfo(FString::Printf(TEXT("Recall against brute force with a candidate budget of %d: %.1f%%"), TestCandidateBudget, recall * 100.0f));
+
+	return TestTrue(FString::Printf(TEXT("Recall of at least %.0f%%"), MinRecall * 100.0f), recall >= MinRecall);
+}
+
+#endif //WITH_DEV_AUTOMATION_TESTS
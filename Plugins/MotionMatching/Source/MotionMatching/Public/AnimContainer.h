@@ -1,27 +1,56 @@
 #pragma once
 
 #include "AnimKey.h"
+#include "MotionMirrorTable.h"
 #include "Animation/AnimSequence.h"
 #include "Animation/AnimNodeBase.h"
 
 
+// Offset of one bone from the incoming pose to the outgoing one, rotations are stored as scaled axes.
+struct FBoneTransitionOffset
+{
+	FVector Translation = FVector::ZeroVector;
+	FVector Rotation = FVector::ZeroVector;
+	FVector Scale = FVector::ZeroVector;
+	FVector TranslationVelocity = FVector::ZeroVector;
+	FVector RotationVelocity = FVector::ZeroVector;
+	FVector ScaleVelocity = FVector::ZeroVector;
+};
+
 struct FAnimContainer
 {
 public:
 	void Init(const TArray<UAnimSequence*>& InAnimationsArray, float InAnimationSampling);
-	void ResetKey();
-	void IncrementKey();
-	FAnimKey MaxKey() const;
+	// Poses and root motion of mirrored keys are mirrored through this table.
+	void SetMirrorTable(const FMotionMirrorTable& InMirrorTable) { MirrorTable = InMirrorTable; }
 	const UAnimSequence& GetAnimation(const FAnimKey& AnimKey) const;
 	FTransform ExtractBlendedRootMotion(const FAnimKey& PreviousAnimKey, const FAnimKey& NewAnimKey, float BlendWeight, float DeltaTime) const;
 	FTransform ExtractRootMotion(const FAnimKey& AnimKey, float DeltaTime) const;
-	void GetBlendedPose(FPoseContext& PoseContext, const FAnimKey& PreviousAnimKey, const FAnimKey& NewAnimKey, float BlendWeight) const;
+	// Samples both poses once and records, per bone, how far the outgoing pose is from the incoming one. The outgoing
+	// pose is the one on screen, its clip plus the current offsets at CurrentBlendWeight. With bComputeVelocities,
+	// how fast that offset is changing is recorded as well, from one more sample of each clip and the current offsets.
+	void StartTransition(const FPoseContext& PoseContext, const FAnimKey& PreviousAnimKey, const FAnimKey& NewAnimKey, float CurrentBlendWeight, bool bComputeVelocities);
+	// Same for the bones of BoneContainer, which needs no animation instance, e.g. in benchmarks.
+	void StartTransition(const FBoneContainer& BoneContainer, const FAnimKey& PreviousAnimKey, const FAnimKey& NewAnimKey, float CurrentBlendWeight, bool bComputeVelocities);
+	// Moves the recorded offsets towards zero with a critically damped spring, the offsets are dropped once settled.
+	void DecayTransition(float DeltaTime, float HalfLife);
+	// Drops the recorded offsets, so that the incoming pose plays as is.
+	void ResetTransition() { TransitionOffsets.Reset(); }
+	// Samples only the incoming pose and adds the recorded offsets scaled by BlendWeight, so the outgoing pose
+	// costs nothing after the transition has started.
+	void GetBlendedPose(FPoseContext& PoseContext, const FAnimKey& NewAnimKey, float BlendWeight) const;
+	void GetBlendedPose(FCompactPose& Pose, FBlendedCurve& Curve, const FAnimKey& NewAnimKey, float BlendWeight) const;
 	void GetPose(FPoseContext& PoseContext, const FAnimKey& AnimKey) const;
 
-	FAnimKey CurrentKey;
-
 private:
+	void GetPose(FCompactPose& Pose, FBlendedCurve& Curve, const FAnimKey& AnimKey) const;
+
 	TArray<UAnimSequence*> AnimationsArray;
 	float AnimationSampling = 0.0f;
+	FMotionMirrorTable MirrorTable;
+	// Indexed by compact pose bone index, reused from one transition to the next:
+	TArray<FBoneTransitionOffset> TransitionOffsets;
+	// Below this, in centimeters, radians or their rates, a decaying transition is considered finished:
+	static constexpr float SettledOffset = 1.e-3f;
 
 };
\ No newline at end of file
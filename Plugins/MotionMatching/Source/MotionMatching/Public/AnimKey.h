@@ -4,11 +4,18 @@ struct FAnimKey
 {
 	int32 Index = 0;
 	float StartTime = 0.0f;
+	// The clip is played mirrored through the database's mirror table.
+	bool bMirrored = false;
 };
 
+inline FArchive& operator<<(FArchive& Ar, FAnimKey& AnimKey)
+{
+	return Ar << AnimKey.Index << AnimKey.StartTime << AnimKey.bMirrored;
+}
+
 inline bool operator==(const FAnimKey& Lhs, const FAnimKey& Rhs) 
 {
-	return (Lhs.Index == Rhs.Index) && FMath::IsNearlyEqual(Lhs.StartTime, Rhs.StartTime);
+	return (Lhs.Index == Rhs.Index) && (Lhs.bMirrored == Rhs.bMirrored) && FMath::IsNearlyEqual(Lhs.StartTime, Rhs.StartTime);
 }
 
 inline bool operator!=(const FAnimKey& Lhs, const FAnimKey& Rhs) 
@@ -18,6 +25,11 @@ inline bool operator!=(const FAnimKey& Lhs, const FAnimKey& Rhs)
 
 inline bool operator<(const FAnimKey& Lhs, const FAnimKey& Rhs) 
 { 
+	if (Lhs.bMirrored != Rhs.bMirrored)
+	{
+		return Rhs.bMirrored;
+	}
+
 	return (Lhs.Index < Rhs.Index) ? true : ((Lhs.Index == Rhs.Index) ? Lhs.StartTime < Rhs.StartTime : false);
 }
 
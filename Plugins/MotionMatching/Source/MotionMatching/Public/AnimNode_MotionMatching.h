@@ -3,11 +3,65 @@
 #include "Animation/AnimNodeBase.h"
 #include "AnimKey.h"
 #include "AnimContainer.h"
-#include "BoneToRootTransforms.h"
+#include "MotionDatabase.h"
+#include "MotionHistoryBuffer.h"
+#include "MotionMatchingCrowd.h"
+#include "MotionMatchingRecording.h"
+#include "MotionMatchingStats.h"
+#include "MotionTrajectoryComponent.h"
 
 #include "AnimNode_MotionMatching.generated.h"
 
 
+class UMotionDatabaseAsset;
+
+UENUM()
+enum class EMotionMatchingSearchExecution : uint8
+{
+	// The search runs in Evaluate_AnyThread on the frame it is due.
+	Immediate,
+	// The search runs as a task launched from Update_AnyThread, the result is picked up on a later frame.
+	Async,
+	// The search is answered by the crowd batcher together with those of other characters, one frame later.
+	CrowdBatched
+};
+
+UENUM()
+enum class EMotionMatchingTransitionMode : uint8
+{
+	// Blends from the outgoing pose over a fixed time, BlendWeightDecrement per 60 Hz frame.
+	Crossfade,
+	// Decays the offset between the outgoing and the incoming pose over time with a critically damped spring.
+	Inertialization
+};
+
+// How much matching one level of detail gets: distant or hidden characters can search less often, on fewer
+// features, with a cheaper search, and cut between clips instead of blending.
+USTRUCT()
+struct FMotionMatchingLODProfile
+{
+	GENERATED_BODY()
+
+	// Seconds between searches, 0 uses the node's UpdateRate.
+	UPROPERTY(EditAnywhere, Category = LOD, meta = (ClampMin = "0.0"))
+	float SearchInterval = 0.0f;
+
+	// Off matches the trajectory alone: bone positions and velocities get a zero weight and the search skips them.
+	UPROPERTY(EditAnywhere, Category = LOD)
+	bool UsePoseFeatures = true;
+
+	// Replaces the node's SearchMode. The index of the mode is built along with the database, for a database asset
+	// the mode has to be one of its AdditionalSearchModes.
+	UPROPERTY(EditAnywhere, Category = LOD)
+	bool UseSearchMode = false;
+	UPROPERTY(EditAnywhere, Category = LOD, meta = (EditCondition = "UseSearchMode"))
+	EMotionMatchingSearchMode SearchMode = EMotionMatchingSearchMode::BruteForce;
+
+	// Off cuts straight to the new clip, which saves sampling the outgoing pose on transitions.
+	UPROPERTY(EditAnywhere, Category = LOD)
+	bool UseBlending = true;
+};
+
 USTRUCT(BlueprintInternalUseOnly)
 struct FAnimNode_MotionMatching : public FAnimNode_Base
 {
@@ -18,9 +72,13 @@ public:
 
 	virtual bool NeedsOnInitializeAnimInstance() const override { return true; }
 	virtual void OnInitializeAnimInstance(const FAnimInstanceProxy* InProxy, const UAnimInstance* InAnimInstance) override;
+	virtual bool HasPreUpdate() const override { return true; }
+	virtual void PreUpdate(const UAnimInstance* InAnimInstance) override;
 	virtual void Evaluate_AnyThread(FPoseContext& Output) override;
 	virtual void Update_AnyThread(const FAnimationUpdateContext& Context) override;
 
+	const FMotionMatchingNodeCounters& GetCounters() const { return Counters; }
+
 	UPROPERTY(EditAnywhere, Category = Parameters, meta = (PinShownByDefault))
 	float AnimationSampling = 0.05f;
 	UPROPERTY(EditAnywhere, Category = Parameters, meta = (PinShownByDefault))
@@ -29,17 +87,28 @@ public:
 	float PoseWeight = 1.0f;
 	UPROPERTY(EditAnywhere, Category = Parameters, meta = (PinShownByDefault))
 	float OrientationWeight = 1.0f;
+	UPROPERTY(EditAnywhere, Category = Parameters, meta = (PinShownByDefault))
+	float VelocityWeight = 1.0f;
 
+	// Seconds between searches, unless the LOD profile of the mesh's current LOD sets its own interval.
 	UPROPERTY(EditAnywhere, Category = Parameters, meta = (PinShownByDefault))
 	float UpdateRate = 0.2f;
+	// How long the clip chosen last has been playing.
 	float UpdateTimer = 0.0f;
 
+	// Length of the desired trajectory built from the raw movement input, only used when the owner has no
+	// UMotionTrajectoryComponent.
 	UPROPERTY(EditAnywhere, Category = Parameters, meta = (PinShownByDefault))
 	float TrajectoryLength = 10.0f;
+
+	// Times in seconds of the trajectory points matched against, negative ones are in the past.
+	UPROPERTY(EditAnywhere, Category = Parameters)
+	TArray<float> TrajectoryTimes = TArray<float>{-0.2f, 0.2f, 0.4f, 0.6f};
 	
 	UPROPERTY(EditAnywhere, Category = Parameters, meta = (PinShownByDefault))
 	float BlendWeightDecrement = 0.01f;
 
+	// Draws the desired and the chosen trajectory of transitions, at most once every DebugRate seconds.
 	UPROPERTY(EditAnywhere, Category = Parameters, meta = (PinShownByDefault))
 	bool IsDebugMode = false;
 	float DebugTimer = 0.0f;
@@ -48,33 +117,143 @@ public:
 	UPROPERTY(EditAnywhere, Category = Parameters, meta = (PinShownByDefault))
 	float DebugLinesLifetime = 3.0f;
 
+	UPROPERTY(EditAnywhere, Category = Search, meta = (PinHiddenByDefault))
+	EMotionMatchingSearchMode SearchMode = EMotionMatchingSearchMode::BruteForce;
+	UPROPERTY(EditAnywhere, Category = Search, meta = (PinHiddenByDefault))
+	EMotionMatchingCostKernel CostKernel = EMotionMatchingCostKernel::Auto;
+	// Stores the features scanned by brute-force searches as scaled integers, trading some accuracy for bandwidth.
+	UPROPERTY(EditAnywhere, Category = Search, meta = (PinHiddenByDefault))
+	EMotionFeatureQuantization Quantization = EMotionFeatureQuantization::None;
+	UPROPERTY(EditAnywhere, Category = Search, meta = (PinHiddenByDefault, ClampMin = "1"))
+	int32 ApproximateCandidateBudget = 32;
+	// Brute-force searches over databases with at least this many samples run in parallel chunks, 0 keeps them serial.
+	UPROPERTY(EditAnywhere, Category = Search, meta = (PinHiddenByDefault, ClampMin = "0"))
+	int32 ParallelSearchThreshold = 0;
+	// Scores the natural continuation of the current clip first: below ContinuationCostThreshold the search is skipped,
+	// otherwise it only looks for something cheaper. A result a few frames away in the current clip keeps it playing.
+	UPROPERTY(EditAnywhere, Category = Search, meta = (PinHiddenByDefault))
+	bool UseContinuationBias = false;
+	UPROPERTY(EditAnywhere, Category = Search, meta = (PinHiddenByDefault, ClampMin = "0.0"))
+	float ContinuationCostThreshold = 1.0f;
+	UPROPERTY(EditAnywhere, Category = Search, meta = (PinHiddenByDefault))
+	EMotionMatchingSearchExecution SearchExecution = EMotionMatchingSearchExecution::Immediate;
+	// Longest time in seconds an asynchronous search may stay pending before evaluation runs it itself, or waits for it
+	// when it is already running.
+	UPROPERTY(EditAnywhere, Category = Search, meta = (PinHiddenByDefault, ClampMin = "0.0"))
+	float MaxSearchLatency = 0.1f;
+
+	// Indexed by the LOD level, LODs past the last profile use the last one. Without profiles every LOD matches like
+	// the node's own settings say.
+	UPROPERTY(EditAnywhere, Category = LOD)
+	TArray<FMotionMatchingLODProfile> LODProfiles;
+	// 0 or more replaces the skeletal mesh's LOD as the level picking the profile, e.g. a level fed from a
+	// significance manager.
+	UPROPERTY(EditAnywhere, Category = LOD, meta = (PinHiddenByDefault))
+	int32 LODLevelOverride = INDEX_NONE;
+
+	UPROPERTY(EditAnywhere, Category = Transition, meta = (PinHiddenByDefault))
+	EMotionMatchingTransitionMode TransitionMode = EMotionMatchingTransitionMode::Crossfade;
+	// Time in seconds for an inertialization transition to halve the remaining offset.
+	UPROPERTY(EditAnywhere, Category = Transition, meta = (PinHiddenByDefault, ClampMin = "0.01"))
+	float InertializationHalfLife = 0.1f;
+
+	// When set, the asset's clips, bones, sampling and mirroring are used instead of the ones below.
+	UPROPERTY(EditAnywhere, Category = MotionData)
+	UMotionDatabaseAsset* MotionDatabase = nullptr;
+
 	UPROPERTY(EditAnywhere, Category = MotionData)
 	TArray<UAnimSequence*> AnimationsArray;
 
 	UPROPERTY(EditAnywhere, Category = MotionData)
 	TArray<FName> BoneNames;
 
+	// Adds every animation a second time, mirrored at runtime, instead of authoring mirrored copies of the clips.
+	UPROPERTY(EditAnywhere, Category = Mirroring)
+	bool UseMirroring = false;
+	// Component space axis across which poses are mirrored, X for skeletons facing along Y.
+	UPROPERTY(EditAnywhere, Category = Mirroring, meta = (EditCondition = "UseMirroring"))
+	TEnumAsByte<EAxis::Type> MirrorAxis = EAxis::X;
+	UPROPERTY(EditAnywhere, Category = Mirroring, meta = (EditCondition = "UseMirroring"))
+	TArray<FMotionMirrorBonePair> MirrorBonePairs;
+
+	// Streams every search decision to a file that MotionMatchingReplay can run again without a world, see
+	// FMotionMatchingRecording. MotionMatching.Record 1 turns recording on for every node.
+	UPROPERTY(EditAnywhere, Category = Recording)
+	bool UseRecording = false;
+	// Relative to the project's Saved directory, recordings are named after the animation instance.
+	UPROPERTY(EditAnywhere, Category = Recording)
+	FString RecordingDirectory = TEXT("MotionMatching");
+
 private:
-	FAnimKey FindLowestCostAnimKey();
-	float ComputeTrajectoryCost(const FTransform& RootMotion) const;
-	float ComputePoseCost() const;
-	float ComputeOrientationCost(float AnimTime, const FTransform& RootMotion) const;
+	const FMotionMatchingLODProfile* GetLODProfile() const;
+	float GetSearchInterval() const;
+	bool ConsumeScheduledSearch();
+	void SearchLowestCostAnimKey();
+	FMotionMatchingSearchSettings GetSearchSettings() const;
+	FAnimKey GetResultAnimKey(const FMotionMatchingSearchResult& Result) const;
+	void ApplySearchResult(const FMotionMatchingSearchResult& Result);
+	FMotionMatchingSearchResult ScoreContinuation() const;
+	bool TryContinueCurrentClip(FMotionMatchingSearchResult& OutContinuation);
+	void ContinueCurrentClip();
+	FMotionMatchingSearchRequestPtr CreateSearchRequest();
+	void UpdateBatchedSearch();
+	void LaunchAsyncSearch();
+	void CompleteAsyncSearch();
+	void StartRecording(const UAnimInstance* InAnimInstance);
+	void RecordSearch(const TArray<float>& Query, const TArray<float>& Weights, const FMotionMatchingSearchSettings& Settings, const FMotionMatchingSearchResult& InitialResult, const FMotionMatchingSearchResult& Result, bool bSkipped, float SearchMicroseconds = 0.0f);
+	void StartTransition(const FAnimKey& AnimKey);
+	void UpdateQueryFeatures();
+	void UpdateQueryTrajectoryFromInput(int32 CurrentSampleIndex);
+	void UpdateQueryWeights();
+	FMotionFeatureWeights GetFeatureWeights() const;
+	void InitHistory();
+	void RecordRootHistory();
+	void RecordBoneHistory(const FPoseContext& Output);
+	bool FindPastRootTransform(float TimeAgo, FTransform& OutTransform) const;
+	void UpdateQueryPoseFromHistory();
 	FVector CalculateCurrentTrajectory() const;
 	void MoveOwnerPawn() const;
-	void LoadBoneToRootTransforms();
-	FTransform GetLoadedBoneToRootTransform(const FName& BoneName, const FAnimKey& AnimKey) const;
 	void DrawDebugTrajectory(const FVector& Trajectory, const FColor& Color = FColor::Green) const;
 
 	FAnimContainer AnimationContainer;
 	USkeletalMeshComponent* SkeletalMeshComponent = nullptr;
 	APawn* OwnerPawn = nullptr;
+	UMotionTrajectoryComponent* TrajectoryComponent = nullptr;
+	// Gathered on the game thread in PreUpdate, with the owner's forward direction in the same space:
+	TArray<FMotionTrajectoryPoint> TrajectoryPoints;
+	FVector TrajectoryForward = FVector::ForwardVector;
 	UWorld* World = nullptr;
 	FAnimKey LowestCostAnimkey = FAnimKey{0, 0.0f};
 	FAnimKey PreviousAnimKey = FAnimKey{ 0, 0.0f };
 	FAnimKey NewAnimKey = FAnimKey{ 0, 0.0f };
 	float GlobalDeltaTime = 0.0f;
-	FVector CurrentTrajectory;
-	TArray<FBoneToRootTransforms> BoneToRootTransformsArray;
+	// Time towards the next search, which is due once it reaches the search interval:
+	float SearchAccumulator = 0.0f;
+	int32 LODLevel = 0;
+	FMotionDatabasePtr Database;
+	FMotionMatchingSearchStats LastSearchStats;
+	FMotionMatchingNodeCounters Counters;
+	FMotionMatchingSearchRequestPtr PendingSearchRequest;
+	float PendingSearchAge = 0.0f;
+	FMotionMatchingSearchResult PendingSearchInitialResult;
+	TSharedPtr<FMotionMatchingRecorder, ESPMode::ThreadSafe> Recorder;
+	TArray<float> QueryFeatures;
+	TArray<float> QueryWeights;
 	float BlendWeight = 1.0f;
+	float OutgoingBlendWeight = 0.0f;
+	bool bIsTransitionPending = false;
+
+	// Sampled this often, the root history reaches about two seconds back:
+	static constexpr float RootHistoryInterval = 1.0f / 30.0f;
+	// The only record of where the character was, past trajectory points are read from it with or without a
+	// UMotionTrajectoryComponent. Written on the game thread in PreUpdate and read by the worker threads building
+	// queries:
+	TMotionHistoryBuffer<FMotionRootSample, 64> RootHistory;
+	FMotionRootSample CurrentRootSample;
+	// One per database bone, written once per frame in Evaluate_AnyThread:
+	TArray<TMotionHistoryBuffer<FMotionBoneSample, 4>> BoneHistories;
+	TArray<int32> HistoryBoneIndices;
+	float HistoryTime = 0.0f;
+	float LastBoneHistoryTime = -1.0f;
 
 };
\ No newline at end of file
@@ -1,34 +1,40 @@
 #pragma once
 
+#include "CoreMinimal.h"
+#include "BoneIndices.h"
+
+
+class UAnimSequence;
+struct FReferenceSkeleton;
+
+// Bone translations relative to the root for every sample of an animation and an arbitrary set of bones, stored
+// contiguously as [sample][bone]. Bone indices refer to the reference skeleton of the animation's skeleton and are
+// resolved once up front; the accessors take the position of the bone in that set.
 struct FBoneToRootTransforms
 {
-	FBoneToRootTransforms(class USkeletalMeshComponent* InSkeletalMeshComponent, class UAnimSequence* InAnimSequence, float InAnimationSampling);
+public:
+	FBoneToRootTransforms(const UAnimSequence* InAnimSequence, const TArray<int32>& InBoneIndices, float InAnimationSampling, bool bInComputeVelocities);
+
+	// Names missing from the skeleton resolve to INDEX_NONE and are cached as zero translations.
+	static void ResolveBoneIndices(const FReferenceSkeleton& InRefSkeleton, const TArray<FName>& InBoneNames, TArray<int32>& OutBoneIndices);
 
-	FTransform GetTransform(int32 BoneIndex, int32 KeyIndex) const;
+	int32 GetNumSamples() const { return NumSamples; }
+	int32 GetNumBones() const { return BoneIndices.Num(); }
+	bool HasVelocities() const { return Velocities.Num() > 0; }
+
+	const FVector& GetTranslation(int32 SampleIndex, int32 BoneIndex) const { return Translations[SampleIndex * GetNumBones() + BoneIndex]; }
+	const FVector& GetVelocity(int32 SampleIndex, int32 BoneIndex) const { return Velocities[SampleIndex * GetNumBones() + BoneIndex]; }
+	const FVector* GetSampleTranslations(int32 SampleIndex) const { return Translations.GetData() + SampleIndex * GetNumBones(); }
+	const FVector* GetSampleVelocities(int32 SampleIndex) const { return Velocities.GetData() + SampleIndex * GetNumBones(); }
 
 private:
-	void LoadBoneToRootTransforms(class UAnimSequence* InAnimSequence, float InAnimationSampling);
-	FTransform CalculateBoneToRootTransform(const class UAnimSequence * InSequence, const float AnimTime, int32 BoneIndex);
-
-	//TODO: Make this more generic
-	UPROPERTY()
-	TArray<FTransform> FootLeft;
-	UPROPERTY()
-	TArray<FTransform> FootRight;
-	UPROPERTY()
-	TArray<FTransform> Head;
-	UPROPERTY()
-	TArray<FTransform> HandLeft;
-	UPROPERTY()
-	TArray<FTransform> HandRight;
-	UPROPERTY()
-	TArray<FTransform> Pelvis;
-
-	int32 FootLeftIndex = 0;
-	int32 FootRightIndex = 0;
-	int32 HeadIndex = 0;
-	int32 HandLeftIndex = 0;
-	int32 HandRightIndex = 0;
-	int32 PelvisIndex = 0;
-
-};
\ No newline at end of file
+	void LoadTranslations(const UAnimSequence* InAnimSequence, float InAnimationSampling);
+	void CalculateVelocities(float InAnimationSampling);
+	void GatherRequiredBones(const FReferenceSkeleton& InRefSkeleton, TArray<FBoneIndexType>& OutRequiredBones) const;
+
+	TArray<int32> BoneIndices;
+	TArray<FVector> Translations;
+	TArray<FVector> Velocities;
+	int32 NumSamples = 0;
+
+};
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MotionFeatureDatabase.h"
+#include "MotionMatchingSearch.h"
+#include "Async/Future.h"
+
+
+class UAnimSequence;
+class USkeleton;
+
+// Everything the shared matching data is built from. Node instances with equal settings share one database.
+struct FMotionDatabaseSettings
+{
+	TArray<UAnimSequence*> Animations;
+	const USkeleton* Skeleton = nullptr;
+	TArray<FName> BoneNames;
+	float AnimationSampling = 0.0f;
+	TArray<float> TrajectoryTimes;
+	EMotionMatchingSearchMode SearchMode = EMotionMatchingSearchMode::BruteForce;
+	// Modes whose index is built as well, for nodes that switch modes with their LOD.
+	TArray<EMotionMatchingSearchMode> AdditionalSearchModes;
+	// Weights the search index is built for, queries may use different ones.
+	FMotionFeatureWeights IndexWeights;
+	EMotionFeatureQuantization Quantization = EMotionFeatureQuantization::None;
+	// Every animation is added a second time, mirrored across the plane normal to MirrorAxis, unless it is None.
+	TEnumAsByte<EAxis::Type> MirrorAxis = EAxis::None;
+	TArray<FMotionMirrorBonePair> MirrorBonePairs;
+	// Covers the clips' raw data, so that clips reimported in the editor are not matched with a database built from
+	// their previous data. Stamped by the cache, always 0 outside the editor.
+	uint32 SourceHash = 0;
+
+	uint32 CalculateSourceHash() const;
+};
+
+bool operator==(const FMotionDatabaseSettings& Lhs, const FMotionDatabaseSettings& Rhs);
+uint32 GetTypeHash(const FMotionDatabaseSettings& Settings);
+
+// Feature data and search index, built once and then only read.
+struct FMotionDatabase
+{
+public:
+	// Bumped whenever the serialized layout of the database or any search index changes, or a default setting does.
+	static constexpr int32 SerializationVersion = 6;
+
+	// Not copyable, the database memory stat counts every database once.
+	FMotionDatabase() = default;
+	FMotionDatabase(const FMotionDatabase&) = delete;
+	FMotionDatabase& operator=(const FMotionDatabase&) = delete;
+	~FMotionDatabase();
+
+	void Build(const FMotionDatabaseSettings& Settings);
+	// Builds from precomputed rows, one clip after the other, instead of sampling Settings.Animations.
+	void BuildFromFeatures(const FMotionDatabaseSettings& Settings, const TArray<float>& Features, const TArray<int32>& AnimationNumSamples);
+	void Serialize(FArchive& Ar);
+	SIZE_T GetAllocatedSize() const;
+
+	FMotionFeatureDatabase FeatureDatabase;
+	// Also used at runtime to mirror the poses and root motion of mirrored samples.
+	FMotionMirrorTable MirrorTable;
+	FMotionMatchingSearchIndex SearchIndex;
+	// The clips' raw data the features were sampled from, see FMotionDatabaseSettings::SourceHash.
+	uint32 SourceHash = 0;
+
+private:
+	void BuildSearchData(const FMotionDatabaseSettings& Settings);
+	void UpdateMemoryStat();
+
+	SIZE_T TrackedMemory = 0;
+
+};
+
+typedef TSharedPtr<const FMotionDatabase, ESPMode::ThreadSafe> FMotionDatabasePtr;
+
+// Module-wide cache handing out the same database to every node built from equal settings. Entries are only weakly
+// referenced, a database is released together with the last node using it. Builds run outside the cache's lock:
+// nodes asking for a database being built wait for that build only.
+class FMotionDatabaseCache
+{
+public:
+	static FMotionDatabaseCache& Get();
+
+	FMotionDatabasePtr FindOrBuild(const FMotionDatabaseSettings& Settings);
+	void Reset();
+
+private:
+	FCriticalSection CriticalSection;
+	TMap<FMotionDatabaseSettings, TWeakPtr<const FMotionDatabase, ESPMode::ThreadSafe>> Databases;
+	// Reserved when a build starts and removed once its database is published in Databases:
+	TMap<FMotionDatabaseSettings, TSharedFuture<FMotionDatabasePtr>> PendingBuilds;
+
+};
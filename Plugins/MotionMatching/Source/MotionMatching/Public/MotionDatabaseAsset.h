@@ -0,0 +1,91 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DataAsset.h"
+#include "MotionDatabase.h"
+#include "MotionDatabaseAsset.generated.h"
+
+
+class UAnimSequence;
+class USkeleton;
+
+// Motion data authored once and baked into the package on save and cook, so that loading it needs no rebuild.
+// A bake made for different settings (or, in the editor, from since modified clips) is dropped on load and replaced
+// by a runtime build.
+UCLASS(BlueprintType)
+class MOTIONMATCHING_API UMotionDatabaseAsset : public UDataAsset
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Serialize(FArchive& Ar) override;
+	virtual void PostLoad() override;
+#if WITH_EDITOR
+	virtual void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
+#endif //WITH_EDITOR
+
+	FMotionDatabaseSettings GetSettings() const;
+	// Returns the baked database when it is up to date, otherwise the one built at runtime for the current settings.
+	FMotionDatabasePtr GetDatabase() const;
+
+	UPROPERTY(EditAnywhere, Category = MotionData)
+	USkeleton* Skeleton = nullptr;
+
+	UPROPERTY(EditAnywhere, Category = MotionData)
+	TArray<UAnimSequence*> AnimationsArray;
+
+	UPROPERTY(EditAnywhere, Category = MotionData)
+	TArray<FName> BoneNames;
+
+	UPROPERTY(EditAnywhere, Category = MotionData)
+	float AnimationSampling = 0.05f;
+
+	// Times in seconds of the trajectory points matched against, negative ones are in the past.
+	UPROPERTY(EditAnywhere, Category = MotionData)
+	TArray<float> TrajectoryTimes = TArray<float>{-0.2f, 0.2f, 0.4f, 0.6f};
+
+	// Adds every animation a second time, mirrored at runtime, instead of authoring mirrored copies of the clips.
+	UPROPERTY(EditAnywhere, Category = Mirroring)
+	bool UseMirroring = false;
+
+	// Component space axis across which poses are mirrored, X for skeletons facing along Y.
+	UPROPERTY(EditAnywhere, Category = Mirroring, meta = (EditCondition = "UseMirroring"))
+	TEnumAsByte<EAxis::Type> MirrorAxis = EAxis::X;
+
+	UPROPERTY(EditAnywhere, Category = Mirroring, meta = (EditCondition = "UseMirroring"))
+	TArray<FMotionMirrorBonePair> MirrorBonePairs;
+
+	UPROPERTY(EditAnywhere, Category = Search)
+	EMotionMatchingSearchMode SearchMode = EMotionMatchingSearchMode::BruteForce;
+
+	// Indices built besides SearchMode's, for nodes whose LOD profiles search with other modes.
+	UPROPERTY(EditAnywhere, Category = Search)
+	TArray<EMotionMatchingSearchMode> AdditionalSearchModes;
+
+	// Stores the features scanned by brute-force searches as scaled integers, trading some accuracy for bandwidth.
+	UPROPERTY(EditAnywhere, Category = Search)
+	EMotionFeatureQuantization Quantization = EMotionFeatureQuantization::None;
+
+	UPROPERTY(EditAnywhere, Category = Search)
+	float TrajectoryWeight = 1.0f;
+
+	UPROPERTY(EditAnywhere, Category = Search)
+	float OrientationWeight = 1.0f;
+
+	UPROPERTY(EditAnywhere, Category = Search)
+	float PoseWeight = 1.0f;
+
+	UPROPERTY(EditAnywhere, Category = Search)
+	float VelocityWeight = 1.0f;
+
+private:
+	// Stable across runs, only uses asset paths and values. The source hash of the clips' raw data is only available
+	// in the editor, see FMotionDatabaseSettings::CalculateSourceHash.
+	uint32 CalculateSettingsHash() const;
+	bool IsBakeUpToDate() const;
+
+	// Its source hash is the one it was built or loaded with:
+	FMotionDatabasePtr BakedDatabase;
+	uint32 BakedSettingsHash = 0;
+
+};
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MotionMatchingCostKernel.h"
+
+
+struct FMotionFeatureDatabase;
+
+// Two layers of per-dimension min/max boxes over runs of consecutive samples inside each animation. Whole runs are
+// rejected when the cost of their box already exceeds the best cost found so far, the rest is scanned with the cost
+// kernel. Results are identical to a brute-force scan and building only takes one pass over the database.
+struct FMotionFeatureAABBTree
+{
+public:
+	void Build(const FMotionFeatureDatabase& Database);
+	void Reset();
+	void Serialize(FArchive& Ar);
+	SIZE_T GetAllocatedSize() const;
+	bool IsBuilt() const { return LargeSegments.Num() > 0; }
+
+	void FindLowestCost(EMotionMatchingCostKernel CostKernel, const FMotionFeatureDatabase& Database, const float* Query, const float* Weights, FMotionMatchingSearchResult& InOutResult, FMotionMatchingSearchStats& OutStats) const;
+
+private:
+	struct FSegment
+	{
+		int32 BeginSample = 0;
+		int32 EndSample = 0;
+		// Large segments only: their small segments are [FirstSmallSegment, EndSmallSegment).
+		int32 FirstSmallSegment = 0;
+		int32 EndSmallSegment = 0;
+
+		friend FArchive& operator<<(FArchive& Ar, FSegment& Segment)
+		{
+			return Ar << Segment.BeginSample << Segment.EndSample << Segment.FirstSmallSegment << Segment.EndSmallSegment;
+		}
+	};
+
+	void AddSegmentBounds(const FMotionFeatureDatabase& Database, const FSegment& Segment, TArray<float>& OutBounds) const;
+
+	static constexpr int32 SmallSegmentSize = 16;
+	static constexpr int32 LargeSegmentSize = 64;
+
+	TArray<FSegment> LargeSegments;
+	TArray<FSegment> SmallSegments;
+	// Per segment: NumDimensions minimums followed by NumDimensions maximums.
+	TArray<float> LargeBounds;
+	TArray<float> SmallBounds;
+
+};
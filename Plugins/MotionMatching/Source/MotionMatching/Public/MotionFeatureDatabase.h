@@ -0,0 +1,122 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AnimKey.h"
+#include "MotionMatchingCostKernel.h"
+#include "MotionMirrorTable.h"
+
+
+class UAnimSequence;
+class USkeleton;
+
+// Weight of every feature channel, expanded to one weight per dimension by the database. Channels without a weight are ignored.
+struct FMotionFeatureWeights
+{
+	float TrajectoryPositions = 1.0f;
+	float TrajectoryFacings = 1.0f;
+	float BonePositions = 1.0f;
+	float BoneVelocities = 1.0f;
+};
+
+inline bool operator==(const FMotionFeatureWeights& Lhs, const FMotionFeatureWeights& Rhs)
+{
+	return (Lhs.TrajectoryPositions == Rhs.TrajectoryPositions)
+		&& (Lhs.TrajectoryFacings == Rhs.TrajectoryFacings)
+		&& (Lhs.BonePositions == Rhs.BonePositions)
+		&& (Lhs.BoneVelocities == Rhs.BoneVelocities);
+}
+
+// Packed matching data for every sample of every animation. Each sample is one contiguous row laid out as:
+// [trajectory positions (3 per point)] [trajectory facings (2 per point)] [bone positions (3 per bone)] [bone velocities (3 per bone)]
+// Rows are stored standardized: every dimension has its database mean subtracted and is divided by the standard
+// deviation of its channel, so channels measured in different units contribute comparably to the cost.
+struct FMotionFeatureDatabase
+{
+public:
+	// Number of samples interleaved per block in the blocked layout consumed by the vectorized cost kernels.
+	static constexpr int32 BlockWidth = 8;
+
+	// With an enabled mirror table, every animation is added a second time, mirrored.
+	void Build(const TArray<UAnimSequence*>& InAnimationsArray, const USkeleton* InSkeleton, const TArray<FName>& InBoneNames, float InAnimationSampling, const TArray<float>& InTrajectoryTimes, const FMotionMirrorTable& InMirrorTable);
+	// Replaces the float blocked features with scaled integers, the rows stay in floats for the search indices.
+	void Quantize(EMotionFeatureQuantization InQuantization);
+	// Builds from raw rows computed elsewhere, e.g. synthetic ones for benchmarks, laid out animation after animation.
+	void BuildFromFeatures(const TArray<float>& InFeatures, const TArray<int32>& InAnimationNumSamples, const TArray<FName>& InBoneNames, float InAnimationSampling, const TArray<float>& InTrajectoryTimes);
+	// Raw rows for BuildFromFeatures in tests and benchmarks: every clip walks, turns and swings its bones at its own
+	// pace, so that rows look like locomotion, smooth within a clip and spread out over the database.
+	static void GenerateSyntheticFeatures(int32 InNumSamples, int32 InNumAnimations, int32 InNumBones, float InAnimationSampling, const TArray<float>& InTrajectoryTimes, int32 InSeed, TArray<float>& OutFeatures, TArray<int32>& OutAnimationNumSamples);
+	void Reset();
+	void Serialize(FArchive& Ar);
+	SIZE_T GetAllocatedSize() const;
+
+	int32 FindSampleIndex(const FAnimKey& AnimKey) const;
+	void ExpandWeights(const FMotionFeatureWeights& InWeights, TArray<float>& OutWeights) const;
+	// Converts raw features, e.g. those of a query, to the standardized space the rows are stored in and back.
+	void NormalizeFeatures(float* InOutFeatures, int32 FirstDimension, int32 NumFeatureDimensions) const;
+	void DenormalizeFeatures(float* InOutFeatures, int32 FirstDimension, int32 NumFeatureDimensions) const;
+
+	int32 GetNumSamples() const { return SampleKeys.Num(); }
+	bool IsValidSampleIndex(int32 SampleIndex) const { return SampleKeys.IsValidIndex(SampleIndex); }
+	// Mirrored animations have their own samples, after those of every unmirrored one. GetAnimationIndex returns
+	// where the animation of a key is among them, INDEX_NONE for a mirrored key in a database without mirroring.
+	int32 GetNumAnimations() const { return AnimationFirstSamples.Num(); }
+	int32 GetAnimationIndex(const FAnimKey& AnimKey) const;
+	bool HasMirroredAnimations() const { return bHasMirroredAnimations; }
+	int32 GetAnimationFirstSample(int32 AnimationIndex) const { return AnimationFirstSamples[AnimationIndex]; }
+	int32 GetAnimationNumSamples(int32 AnimationIndex) const { return AnimationNumSamples[AnimationIndex]; }
+	int32 GetNumDimensions() const { return NumDimensions; }
+	int32 GetNumTrajectoryPoints() const { return TrajectoryTimes.Num(); }
+	float GetTrajectoryTime(int32 PointIndex) const { return TrajectoryTimes[PointIndex]; }
+	// Negative times are points in the past.
+	const TArray<float>& GetTrajectoryTimes() const { return TrajectoryTimes; }
+	int32 GetNumBones() const { return BoneNames.Num(); }
+	const TArray<FName>& GetBoneNames() const { return BoneNames; }
+
+	int32 GetTrajectoryPositionsOffset() const { return 0; }
+	int32 GetTrajectoryFacingsOffset() const { return 3 * GetNumTrajectoryPoints(); }
+	int32 GetBonePositionsOffset() const { return GetTrajectoryFacingsOffset() + 2 * GetNumTrajectoryPoints(); }
+	int32 GetBoneVelocitiesOffset() const { return GetBonePositionsOffset() + 3 * GetNumBones(); }
+
+	const float* GetFeatures(int32 SampleIndex) const { return Features.GetData() + SampleIndex * NumDimensions; }
+	const FAnimKey& GetAnimKey(int32 SampleIndex) const { return SampleKeys[SampleIndex]; }
+
+	// Blocked layout: [block][dimension][lane], BlockWidth samples per block, padded lanes are zeroed.
+	int32 GetNumBlocks() const { return (GetNumSamples() + BlockWidth - 1) / BlockWidth; }
+	const float* GetFeatureBlock(int32 BlockIndex) const { return BlockedFeatures.GetData() + BlockIndex * NumDimensions * BlockWidth; }
+
+	// Quantized blocked layout, same order as the float one. A stored value q stands for q * Scale + Offset.
+	EMotionFeatureQuantization GetQuantization() const { return Quantization; }
+	template <typename ValueType>
+	const ValueType* GetQuantizedBlock(int32 BlockIndex) const { return reinterpret_cast<const ValueType*>(QuantizedFeatures.GetData()) + BlockIndex * NumDimensions * BlockWidth; }
+	float GetQuantizationScale(int32 Dimension) const { return QuantizationScales[Dimension]; }
+	float GetQuantizationOffset(int32 Dimension) const { return QuantizationOffsets[Dimension]; }
+	// The value the cost kernels scan for a feature, dequantized when the database is quantized.
+	float GetScannedFeature(int32 SampleIndex, int32 Dimension) const;
+	// Largest difference between a feature and its dequantized value, in standardized units.
+	float GetQuantizationError() const { return QuantizationError; }
+
+private:
+	// Samples are mirrored when a mirror table is given.
+	void AddAnimationSamples(int32 AnimationIndex, UAnimSequence* InAnimSequence, const TArray<int32>& BoneIndices, const FMotionMirrorTable* MirrorTable);
+	void NormalizeRows();
+	void BuildBlockedFeatures();
+
+	TArray<float> Features;
+	TArray<float> FeatureMeans;
+	TArray<float> FeatureDeviations;
+	TArray<float> BlockedFeatures;
+	TArray<uint8> QuantizedFeatures;
+	TArray<float> QuantizationScales;
+	TArray<float> QuantizationOffsets;
+	float QuantizationError = 0.0f;
+	EMotionFeatureQuantization Quantization = EMotionFeatureQuantization::None;
+	TArray<FAnimKey> SampleKeys;
+	TArray<int32> AnimationFirstSamples;
+	TArray<int32> AnimationNumSamples;
+	TArray<float> TrajectoryTimes;
+	TArray<FName> BoneNames;
+	float AnimationSampling = 0.0f;
+	int32 NumDimensions = 0;
+	bool bHasMirroredAnimations = false;
+
+};
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MotionMatchingCostKernel.h"
+
+
+struct FMotionFeatureDatabase;
+
+// Hierarchical navigable small world graph over the database rows for approximate nearest-neighbour search.
+// CandidateBudget is the number of candidates kept while walking the bottom layer: larger budgets raise recall
+// and cost, a budget close to the database size degenerates into an exhaustive search.
+struct FMotionFeatureHNSW
+{
+public:
+	void Build(const FMotionFeatureDatabase& Database, const float* Weights);
+	void Reset();
+	void Serialize(FArchive& Ar);
+	SIZE_T GetAllocatedSize() const;
+	bool IsBuilt() const { return EntryPoint != INDEX_NONE; }
+
+	void FindLowestCost(const FMotionFeatureDatabase& Database, const float* Query, const float* Weights, int32 CandidateBudget, FMotionMatchingSearchResult& InOutResult, FMotionMatchingSearchStats& OutStats) const;
+
+	// Fraction of NumQueries generated queries for which the approximate search finds the brute-force match.
+	float MeasureRecall(const FMotionFeatureDatabase& Database, const float* Weights, int32 CandidateBudget, int32 NumQueries) const;
+
+private:
+	// Cost and sample index.
+	typedef TPair<float, int32> FCandidate;
+
+	// Samples visited by a walk, in an open-addressing hash set on the mem stack: a walk costs what it visits rather
+	// than the size of the database, and nothing outlives the FMemMark the walks run in.
+	struct FVisitedSamples
+	{
+	public:
+		explicit FVisitedSamples(int32 ExpectedVisits);
+		void StartWalk();
+		// Returns false when the sample was already visited during this walk.
+		bool Visit(int32 SampleIndex);
+
+	private:
+		void Allocate(int32 InNumSlots);
+		void Grow();
+
+		// INDEX_NONE marks an empty slot:
+		int32* Slots = nullptr;
+		int32 NumSlots = 0;
+		int32 NumVisited = 0;
+	};
+
+	int32 GetNumLinks(int32 SampleIndex, int32 Layer) const { return LinkCounts[CountOffsets[SampleIndex] + Layer]; }
+	const int32* GetLinks(int32 SampleIndex, int32 Layer) const { return Links.GetData() + GetLinksOffset(SampleIndex, Layer); }
+	int32 GetLinksOffset(int32 SampleIndex, int32 Layer) const { return LinkOffsets[SampleIndex] + (Layer == 0 ? 0 : MaxLinksLayer0 + (Layer - 1) * MaxLinks); }
+	static int32 GetMaxLinks(int32 Layer) { return Layer == 0 ? MaxLinksLayer0 : MaxLinks; }
+
+	void DescendToLayer(const FMotionFeatureDatabase& Database, const float* Query, const float* Weights, int32 TargetLayer, FCandidate& InOutNearest, int32& InOutEvaluated) const;
+	void SearchLayer(const FMotionFeatureDatabase& Database, const float* Query, const float* Weights, int32 Layer, int32 CandidateBudget, TArray<FCandidate>& InOutNearest, FVisitedSamples& Visited, int32& InOutEvaluated) const;
+	void SelectNeighbors(const FMotionFeatureDatabase& Database, const float* Weights, TArray<FCandidate>& Candidates, int32 NumNeighbors, TArray<int32>& OutNeighbors) const;
+	void SetLinks(int32 SampleIndex, int32 Layer, const TArray<int32>& InLinks);
+
+	static constexpr int32 MaxLinks = 16;
+	static constexpr int32 MaxLinksLayer0 = 2 * MaxLinks;
+	static constexpr int32 MaxLayers = 16;
+	static constexpr int32 ConstructionBudget = 64;
+	static constexpr int32 RandomSeed = 0x4D4D;
+
+	// Per sample: MaxLinksLayer0 slots for layer 0 followed by MaxLinks slots for every upper layer it belongs to.
+	TArray<int32> Links;
+	TArray<int32> LinkOffsets;
+	// Per sample: one count per layer it belongs to.
+	TArray<uint8> LinkCounts;
+	TArray<int32> CountOffsets;
+	TArray<uint8> Levels;
+	int32 EntryPoint = INDEX_NONE;
+	int32 TopLayer = 0;
+
+};
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MotionMatchingCostKernel.h"
+
+
+struct FMotionFeatureDatabase;
+
+// Exact nearest-neighbour index over the database rows. Splits are chosen on the dimensions that matter most for
+// SplitWeights, but the branch-and-bound search stays exact for any non-negative query weights.
+struct FMotionFeatureKDTree
+{
+public:
+	void Build(const FMotionFeatureDatabase& Database, const float* SplitWeights);
+	void Reset();
+	void Serialize(FArchive& Ar);
+	SIZE_T GetAllocatedSize() const;
+	bool IsBuilt() const { return Nodes.Num() > 0; }
+
+	// Returns the same sample and cost as a brute-force scan (lowest sample index wins ties).
+	void FindLowestCost(const FMotionFeatureDatabase& Database, const float* Query, const float* Weights, FMotionMatchingSearchResult& InOutResult, FMotionMatchingSearchStats& OutStats) const;
+
+private:
+	struct FNode
+	{
+		// INDEX_NONE for leaves.
+		int32 SplitDimension = INDEX_NONE;
+		float SplitValue = 0.0f;
+		// Inner nodes: the left child is the next node and RightChild is stored. Leaves: range in SampleOrder.
+		int32 RightChild = INDEX_NONE;
+		int32 BeginSample = 0;
+		int32 EndSample = 0;
+
+		friend FArchive& operator<<(FArchive& Ar, FNode& Node)
+		{
+			return Ar << Node.SplitDimension << Node.SplitValue << Node.RightChild << Node.BeginSample << Node.EndSample;
+		}
+	};
+
+	struct FSearchContext;
+
+	int32 BuildNode(const FMotionFeatureDatabase& Database, const float* SplitWeights, int32 BeginSample, int32 EndSample);
+	void SearchNode(int32 NodeIndex, float LowerBound, FSearchContext& Context) const;
+
+	static constexpr int32 LeafSize = 16;
+
+	TArray<FNode> Nodes;
+	TArray<int32> SampleOrder;
+
+};
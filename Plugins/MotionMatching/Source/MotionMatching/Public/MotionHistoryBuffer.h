@@ -0,0 +1,109 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+
+// Fixed-capacity ring buffer of recent samples, written by one thread at a time and read from any thread without
+// locks. Every slot is guarded by a sequence number that is odd while the slot is being written (a seqlock): readers
+// copy the element and retry when the sequence changed meanwhile. Elements have to be trivially copyable.
+template <typename ElementType, int32 Capacity>
+class TMotionHistoryBuffer
+{
+public:
+	TMotionHistoryBuffer() = default;
+
+	// Copies are only made while nothing writes to either buffer, e.g. when the owning node is copied.
+	TMotionHistoryBuffer(const TMotionHistoryBuffer& Other)
+	{
+		*this = Other;
+	}
+
+	TMotionHistoryBuffer& operator=(const TMotionHistoryBuffer& Other)
+	{
+		for (int32 slotIndex = 0; slotIndex < Capacity; ++slotIndex)
+		{
+			Slots[slotIndex].Sequence = Other.Slots[slotIndex].Sequence.Load();
+			Slots[slotIndex].Element = Other.Slots[slotIndex].Element;
+		}
+
+		NumPushed = Other.NumPushed.Load();
+
+		return *this;
+	}
+
+	void Push(const ElementType& Element)
+	{
+		const uint32 numPushed = NumPushed.Load();
+		FSlot& slot = Slots[numPushed % Capacity];
+
+		++slot.Sequence;
+		FPlatformMisc::MemoryBarrier();
+		slot.Element = Element;
+		FPlatformMisc::MemoryBarrier();
+		++slot.Sequence;
+
+		NumPushed = numPushed + 1;
+	}
+
+	// Copies the element pushed Age pushes before the newest one, fails if it was never recorded or is overwritten.
+	bool Get(int32 Age, ElementType& OutElement) const
+	{
+		while (true)
+		{
+			const uint32 numPushed = NumPushed.Load();
+
+			if (Age < 0 || static_cast<uint32>(Age) >= FMath::Min<uint32>(numPushed, Capacity))
+			{
+				return false;
+			}
+
+			const FSlot& slot = Slots[(numPushed - 1 - Age) % Capacity];
+			const uint32 sequence = slot.Sequence.Load();
+			FPlatformMisc::MemoryBarrier();
+			OutElement = slot.Element;
+			FPlatformMisc::MemoryBarrier();
+
+			// The slot was neither being written nor rewritten for a newer push while it was copied:
+			if ((sequence & 1) == 0 && slot.Sequence.Load() == sequence && NumPushed.Load() - numPushed < Capacity - Age)
+			{
+				return true;
+			}
+		}
+	}
+
+	int32 Num() const
+	{
+		return FMath::Min<uint32>(NumPushed.Load(), Capacity);
+	}
+
+	void Reset()
+	{
+		NumPushed = 0;
+	}
+
+private:
+	struct FSlot
+	{
+		TAtomic<uint32> Sequence{0};
+		ElementType Element;
+	};
+
+	FSlot Slots[Capacity];
+	TAtomic<uint32> NumPushed{0};
+
+};
+
+// Where the character was, in the space its trajectory is matched in: the owner's location with the skeletal mesh
+// component's rotation.
+struct FMotionRootSample
+{
+	FTransform Transform;
+	float Time = 0.0f;
+};
+
+// Component space position of a matched bone in the evaluated pose.
+struct FMotionBoneSample
+{
+	FVector Position = FVector::ZeroVector;
+	float Time = 0.0f;
+};
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "MotionMatchingBenchmarkCommandlet.generated.h"
+
+
+// Headless benchmark of the database build, the searches and playback, e.g.
+//   UE4Editor-Cmd <Project> -run=MotionMatchingBenchmark -nullrhi -Samples=50000 -Bones=6 -Queries=2000 -Csv=Bench.csv
+// Databases are built from synthetic rows of the requested size, every search mode then answers the same fixed query
+// set. Reports build time, memory, nanoseconds per evaluated candidate, p50/p99 latency and how often each mode
+// agrees with the brute-force match. Synthetic clips of the same size, generated in the editor, time the full build
+// with its bone transform extraction, and FAnimContainer's GetBlendedPose and StartTransition over -Frames frames.
+// With -Database=<asset path>, the asset's real clips go through both benchmarks as well.
+// -MinAgreement=<0..1> and -MaxP99=<microseconds> fail the run, returning 1, when any search configuration agrees
+// less or is slower than that.
+UCLASS()
+class UMotionMatchingBenchmarkCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UMotionMatchingBenchmarkCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+#include "MotionMatchingCostKernel.generated.h"
+
+
+struct FMotionFeatureDatabase;
+
+UENUM()
+enum class EMotionMatchingCostKernel : uint8
+{
+	Auto,
+	Scalar,
+	SSE,
+	AVX2,
+	NEON
+};
+
+// Storage of the blocked features scanned by the brute-force kernels.
+UENUM()
+enum class EMotionFeatureQuantization : uint8
+{
+	// 32-bit floats, costs are exact.
+	None,
+	// Scaled 16-bit integers per dimension, half the memory traffic.
+	Int16,
+	// Scaled 8-bit integers per dimension, a quarter of the memory traffic.
+	Int8
+};
+
+struct FMotionMatchingSearchResult
+{
+	int32 SampleIndex = INDEX_NONE;
+	float Cost = MAX_flt;
+};
+
+struct FMotionMatchingSearchStats
+{
+	int32 CandidatesEvaluated = 0;
+	int32 CandidatesPruned = 0;
+
+	float GetPrunedFraction() const
+	{
+		const int32 numCandidates = CandidatesEvaluated + CandidatesPruned;
+
+		return numCandidates > 0 ? static_cast<float>(CandidatesPruned) / numCandidates : 0.0f;
+	}
+};
+
+// Weighted squared distance between a query and the database rows. Every kernel accumulates the dimensions in the
+// same order with separate multiplies and adds, so all of them return bit-identical costs and pick the same sample.
+// The lowest sample index wins ties, whatever order ranges are scanned in.
+namespace MotionMatchingCostKernel
+{
+	// Query prepared for repeated scans. Dimensions with a zero weight add exactly zero to the cost, so they are dropped.
+	struct FActiveDimensions
+	{
+		FActiveDimensions(const float* InQuery, const float* InWeights, int32 NumDimensions);
+
+		int32 Num() const { return Dimensions.Num(); }
+
+		TArray<int32, TInlineAllocator<64>> Dimensions;
+		TArray<float, TInlineAllocator<64>> Query;
+		TArray<float, TInlineAllocator<64>> Weights;
+	};
+
+	// Returns the kernel that will actually run on this CPU for the requested one.
+	EMotionMatchingCostKernel Resolve(EMotionMatchingCostKernel Kernel);
+
+	float ComputeCost(const float* Features, const float* Query, const float* Weights, int32 NumDimensions);
+
+	// Scans samples [BeginSample, EndSample) and updates InOutResult if any of them is cheaper (or as cheap with a lower index).
+	// Quantized databases are scanned in their stored precision: every feature is off by at most GetQuantizationError.
+	void FindLowestCost(EMotionMatchingCostKernel Kernel, const FMotionFeatureDatabase& Database, const float* Query, const float* Weights, int32 BeginSample, int32 EndSample, FMotionMatchingSearchResult& InOutResult);
+	void FindLowestCost(EMotionMatchingCostKernel Kernel, const FMotionFeatureDatabase& Database, const FActiveDimensions& Active, int32 BeginSample, int32 EndSample, FMotionMatchingSearchResult& InOutResult);
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MotionDatabase.h"
+#include "Async/Future.h"
+
+
+// A search handed over by a node to be answered later. The query and weights are copies, so the node can keep
+// updating its own while the request is pending.
+struct FMotionMatchingSearchRequest
+{
+public:
+	// Runs the search on the calling thread and marks the request as done.
+	void Execute();
+	// Runs the search unless another thread has already started it, in which case it returns false. The task of an
+	// asynchronous request and a node that cannot wait any longer race for it, so the search never waits in a queue.
+	bool TryExecute();
+	bool IsDone() const { return bIsDone; }
+	void MarkDone() { bIsDone = true; }
+	// Blocks until the task running an asynchronous request has finished.
+	void Wait() const;
+
+	FMotionDatabasePtr Database;
+	FMotionMatchingSearchSettings Settings;
+	TArray<float> Query;
+	TArray<float> Weights;
+	FMotionMatchingSearchResult Result;
+	FMotionMatchingSearchStats Stats;
+	// Only set for requests running as a task.
+	TFuture<void> Task;
+
+private:
+	TAtomic<bool> bIsStarted{false};
+	TAtomic<bool> bIsDone{false};
+
+};
+
+typedef TSharedPtr<FMotionMatchingSearchRequest, ESPMode::ThreadSafe> FMotionMatchingSearchRequestPtr;
+
+// Collects the searches of every node during a frame and answers them together once per frame, one database tile
+// at a time for many queries, so each tile is read from memory once instead of once per character. Results are
+// available to the nodes on the following frame.
+class FMotionMatchingCrowd
+{
+public:
+	static FMotionMatchingCrowd& Get();
+
+	void Startup();
+	void Shutdown();
+
+	// Safe to call from any thread.
+	void Submit(const FMotionMatchingSearchRequestPtr& Request);
+	// Answers every request submitted so far.
+	void ProcessPendingRequests();
+
+private:
+	bool Tick(float DeltaTime);
+
+	// Database samples scanned by every query of a group before moving on, sized to stay in the L2 cache.
+	static constexpr int32 TileSize = 256;
+	static constexpr int32 MaxQueriesPerGroup = 32;
+
+	FCriticalSection CriticalSection;
+	TArray<FMotionMatchingSearchRequestPtr> PendingRequests;
+	TArray<FMotionMatchingSearchRequestPtr> ProcessedRequests;
+	FDelegateHandle TickerHandle;
+
+};
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AnimKey.h"
+#include "MotionDatabase.h"
+
+
+// One search decision of a node: the query it searched with and what it chose. Skipped searches kept playing the
+// current clip because its continuation was cheap enough, their result is that continuation.
+struct FMotionMatchingRecordedSearch
+{
+	float Time = 0.0f;
+	TArray<float> Query;
+	TArray<float> Weights;
+	// Changes with the node's LOD profile, the other search settings are the recording's.
+	EMotionMatchingSearchMode SearchMode = EMotionMatchingSearchMode::BruteForce;
+	// What the search started from, the continuation of the current clip when the node scores it first:
+	FMotionMatchingSearchResult InitialResult;
+	FMotionMatchingSearchResult Result;
+	FAnimKey AnimKey;
+	// 0 when unknown, e.g. for searches answered on another thread.
+	float SearchMicroseconds = 0.0f;
+	bool bSkipped = false;
+};
+
+// Recordings start with the database the node searched and its search settings, followed by one entry per search
+// decision. Weights are only written when they change, so that entries stay close to the size of the query.
+struct FMotionMatchingRecording
+{
+public:
+	// Bumped whenever the layout of a recording changes.
+	static constexpr int32 Version = 2;
+
+	bool Load(const FString& Path);
+
+	// Null when the recording was made with a different database serialization version.
+	FMotionDatabasePtr Database;
+	FMotionMatchingSearchSettings SearchSettings;
+	TArray<FMotionMatchingRecordedSearch> Searches;
+
+};
+
+// Streams the search decisions of one node to a file, written from whichever thread evaluates the node.
+class FMotionMatchingRecorder
+{
+public:
+	~FMotionMatchingRecorder();
+
+	bool Open(const FString& Path, const FMotionDatabase& Database, const FMotionMatchingSearchSettings& SearchSettings);
+	void Close();
+	bool IsOpen() const { return Writer.IsValid(); }
+
+	void Record(const FMotionMatchingRecordedSearch& Search);
+
+private:
+	TUniquePtr<FArchive> Writer;
+	TArray<float> LastWeights;
+
+};
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "MotionMatchingReplayCommandlet.generated.h"
+
+
+// Runs the searches of a recording again, without a world or pawn, and compares what they choose and how long they
+// take with the recording, e.g.
+//   UE4Editor-Cmd <Project> -run=MotionMatchingReplay -nullrhi -Recording=Saved/MotionMatching/Hero.mmrec
+// -SearchMode=, -CostKernel= and -Budget= override the recorded search settings, -Database=<asset path> replaces the
+// recorded database with the asset's. -Output=<file> writes the replayed decisions as a new recording, so replaying
+// that one with another build diffs the two builds. Returns 1 when any decision differs.
+UCLASS()
+class UMotionMatchingReplayCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UMotionMatchingReplayCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MotionMatchingCostKernel.h"
+#include "MotionFeatureKDTree.h"
+#include "MotionFeatureAABBTree.h"
+#include "MotionFeatureHNSW.h"
+
+#include "MotionMatchingSearch.generated.h"
+
+
+struct FMotionFeatureDatabase;
+
+UENUM()
+enum class EMotionMatchingSearchMode : uint8
+{
+	BruteForce,
+	KDTree,
+	AABBTree,
+	Approximate
+};
+
+struct FMotionMatchingSearchSettings
+{
+	EMotionMatchingSearchMode SearchMode = EMotionMatchingSearchMode::BruteForce;
+	EMotionMatchingCostKernel CostKernel = EMotionMatchingCostKernel::Auto;
+	// Only used by the approximate search.
+	int32 CandidateBudget = 32;
+	// Brute-force searches over at least this many samples are split into chunks searched in parallel, 0 keeps them serial.
+	int32 ParallelSearchThreshold = 0;
+};
+
+// Acceleration structures built over a feature database. Only the structures needed by the requested modes are built.
+struct FMotionMatchingSearchIndex
+{
+public:
+	void Build(const FMotionFeatureDatabase& Database, const float* Weights, const TArray<EMotionMatchingSearchMode>& SearchModes);
+	void Reset();
+	void Serialize(FArchive& Ar);
+	SIZE_T GetAllocatedSize() const;
+
+	bool Supports(EMotionMatchingSearchMode SearchMode) const;
+
+	FMotionFeatureKDTree KDTree;
+	FMotionFeatureAABBTree AABBTree;
+	FMotionFeatureHNSW HNSW;
+
+};
+
+namespace MotionMatchingSearch
+{
+	// Falls back to the brute-force kernel when the index was not built for SearchMode.
+	void FindLowestCost(const FMotionMatchingSearchSettings& Settings, const FMotionFeatureDatabase& Database, const FMotionMatchingSearchIndex& SearchIndex, const float* Query, const float* Weights, FMotionMatchingSearchResult& InOutResult, FMotionMatchingSearchStats& OutStats);
+	// Cost of one sample exactly as FindLowestCost with the same settings scores it: scans read the stored, possibly
+	// quantized, features through Settings.CostKernel, the KD-tree and approximate searches the float rows.
+	float ComputeSampleCost(const FMotionMatchingSearchSettings& Settings, const FMotionFeatureDatabase& Database, const FMotionMatchingSearchIndex& SearchIndex, int32 SampleIndex, const float* Query, const float* Weights);
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+
+// Caps the searches all nodes start in one frame at MotionMatching.MaxSearchesPerFrame, 0 leaves them unlimited.
+// A node over the budget keeps its search due and asks again on the next frame, so the cost of a crowd stays flat
+// while individual searches run a little late.
+class FMotionMatchingSearchBudget
+{
+public:
+	static FMotionMatchingSearchBudget& Get();
+
+	// Safe to call from any thread.
+	bool TryAcquire();
+
+private:
+	FCriticalSection CriticalSection;
+	uint64 Frame = 0;
+	int32 NumAcquired = 0;
+
+};
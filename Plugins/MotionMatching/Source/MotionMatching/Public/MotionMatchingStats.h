@@ -0,0 +1,64 @@
+#pragma once
+
+#include "Stats/Stats.h"
+#include "MotionMatchingCostKernel.h"
+
+
+DECLARE_STATS_GROUP(TEXT("MotionMatching"), STATGROUP_MotionMatching, STATCAT_Advanced);
+
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Search"), STAT_MotionMatchingSearch, STATGROUP_MotionMatching, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Batched Search"), STAT_MotionMatchingBatchedSearch, STATGROUP_MotionMatching, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Pose Evaluation"), STAT_MotionMatchingPoseEvaluation, STATGROUP_MotionMatching, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Root Motion Extraction"), STAT_MotionMatchingRootMotion, STATGROUP_MotionMatching, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Database Build"), STAT_MotionMatchingDatabaseBuild, STATGROUP_MotionMatching, );
+DECLARE_MEMORY_STAT_EXTERN(TEXT("Database Memory"), STAT_MotionMatchingDatabaseMemory, STATGROUP_MotionMatching, );
+
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Searches"), STAT_MotionMatchingSearches, STATGROUP_MotionMatching, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Candidates Evaluated"), STAT_MotionMatchingCandidatesEvaluated, STATGROUP_MotionMatching, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Candidates Pruned"), STAT_MotionMatchingCandidatesPruned, STATGROUP_MotionMatching, );
+DECLARE_FLOAT_COUNTER_STAT_EXTERN(TEXT("Pruned Fraction (last search)"), STAT_MotionMatchingPrunedFraction, STATGROUP_MotionMatching, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Batched Queries"), STAT_MotionMatchingBatchedQueries, STATGROUP_MotionMatching, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Skipped Searches"), STAT_MotionMatchingSkippedSearches, STATGROUP_MotionMatching, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Deferred Searches"), STAT_MotionMatchingDeferredSearches, STATGROUP_MotionMatching, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Match Switches"), STAT_MotionMatchingMatchSwitches, STATGROUP_MotionMatching, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Best Cost < 0.5"), STAT_MotionMatchingBestCost0, STATGROUP_MotionMatching, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Best Cost < 1"), STAT_MotionMatchingBestCost1, STATGROUP_MotionMatching, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Best Cost < 2"), STAT_MotionMatchingBestCost2, STATGROUP_MotionMatching, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Best Cost < 4"), STAT_MotionMatchingBestCost3, STATGROUP_MotionMatching, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Best Cost < 8"), STAT_MotionMatchingBestCost4, STATGROUP_MotionMatching, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Best Cost >= 8"), STAT_MotionMatchingBestCost5, STATGROUP_MotionMatching, );
+
+// Running totals of one node's matching work. The same numbers summed over every node make up the MotionMatching stat
+// group, searches are also sent to the MotionMatching trace logger for Unreal Insights.
+struct FMotionMatchingNodeCounters
+{
+public:
+	// Best costs are bucketed by powers of two, from below 0.5 up to 8 and above.
+	static constexpr int32 NumCostBuckets = 6;
+
+	static int32 GetCostBucket(float Cost);
+
+	void RecordSearch(const FMotionMatchingSearchResult& Result, const FMotionMatchingSearchStats& Stats);
+	void RecordSkippedSearch();
+	// A due search that did not fit in the frame's search budget, counted once per frame it waits.
+	void RecordDeferredSearch();
+	void RecordMatchSwitch();
+	void Tick(float DeltaTime);
+	void Reset();
+
+	int32 NumSearches = 0;
+	int32 NumSkippedSearches = 0;
+	int32 NumDeferredSearches = 0;
+	int32 NumMatchSwitches = 0;
+	int64 CandidatesEvaluated = 0;
+	int64 CandidatesPruned = 0;
+	float LastBestCost = 0.0f;
+	// Completed searches, measured over the last full second:
+	float SearchesPerSecond = 0.0f;
+	int32 BestCostHistogram[NumCostBuckets] = {};
+
+private:
+	int32 WindowSearches = 0;
+	float WindowTime = 0.0f;
+
+};
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BonePose.h"
+#include "MotionMirrorTable.generated.h"
+
+
+struct FReferenceSkeleton;
+
+// Two bones that trade places when a pose is mirrored, e.g. hand_l and hand_r.
+USTRUCT()
+struct FMotionMirrorBonePair
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditAnywhere, Category = Mirroring)
+	FName BoneName;
+
+	UPROPERTY(EditAnywhere, Category = Mirroring)
+	FName MirroredBoneName;
+};
+
+inline bool operator==(const FMotionMirrorBonePair& Lhs, const FMotionMirrorBonePair& Rhs)
+{
+	return (Lhs.BoneName == Rhs.BoneName) && (Lhs.MirroredBoneName == Rhs.MirroredBoneName);
+}
+
+// Mirrors poses, root motion and root space features across the plane normal to Axis, in component space. Bones
+// without a pair mirror onto themselves. Each bone's reference rotation is kept, so skeletons whose left and right
+// bones have differently oriented axes mirror correctly. The root bone is assumed to be symmetric.
+struct FMotionMirrorTable
+{
+public:
+	void Build(const FReferenceSkeleton& InRefSkeleton, const TArray<FMotionMirrorBonePair>& InBonePairs, EAxis::Type InAxis);
+	void Reset();
+	void Serialize(FArchive& Ar);
+	SIZE_T GetAllocatedSize() const;
+
+	bool IsEnabled() const { return Axis != EAxis::None; }
+	// Indices refer to the reference skeleton the table was built from.
+	int32 GetMirroredBoneIndex(int32 BoneIndex) const { return MirroredBoneIndices.IsValidIndex(BoneIndex) ? MirroredBoneIndices[BoneIndex] : BoneIndex; }
+
+	FVector MirrorVector(const FVector& Vector) const;
+	FQuat MirrorRotation(const FQuat& Rotation) const;
+	FTransform MirrorTransform(const FTransform& Transform) const;
+	void MirrorPose(FCompactPose& Pose) const;
+
+private:
+	TArray<int32> MirroredBoneIndices;
+	// Per bone, what turns its mirrored counterpart's reference rotation into its own, applied in the bone's frame:
+	TArray<FQuat> RotationCorrections;
+	TEnumAsByte<EAxis::Type> Axis = EAxis::None;
+
+};
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "MotionTrajectoryComponent.generated.h"
+
+
+// A point of the character's trajectory, expressed in the space it was requested in.
+struct FMotionTrajectoryPoint
+{
+	FVector Position = FVector::ZeroVector;
+	FVector Facing = FVector::ForwardVector;
+};
+
+// Predicts where the owning pawn is heading by driving its velocity and facing towards the movement input with
+// critically damped springs. Motion matching nodes of the pawn's animation blueprint pick it up automatically and build
+// the future points of their trajectory query from it, past points come from the node's own root history.
+UCLASS(ClassGroup = MotionMatching, meta = (BlueprintSpawnableComponent))
+class MOTIONMATCHING_API UMotionTrajectoryComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	UMotionTrajectoryComponent();
+
+	virtual void BeginPlay() override;
+	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+	// Negative times give the current location and facing, the component keeps no history. Only call it on the game
+	// thread.
+	void GetTrajectory(const TArray<float>& Times, const FTransform& Space, TArray<FMotionTrajectoryPoint>& OutPoints) const;
+
+	// Speed in cm/s reached with full movement input.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Trajectory)
+	float MaxSpeed = 400.0f;
+
+	// Time in seconds for the velocity to close half of the gap to the desired one.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Trajectory, meta = (ClampMin = "0.01"))
+	float VelocityHalfLife = 0.2f;
+
+	// Time in seconds for the facing to close half of the gap to the desired one.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Trajectory, meta = (ClampMin = "0.01"))
+	float FacingHalfLife = 0.3f;
+
+	// When set, the character is predicted to face the control rotation (strafing) instead of its movement direction.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Trajectory)
+	bool FaceControlRotation = false;
+
+private:
+	FVector PredictPosition(float Time) const;
+	float PredictYaw(float Time) const;
+
+	// Simulated state, relative to the owner's current location and yaw:
+	FVector Velocity = FVector::ZeroVector;
+	FVector Acceleration = FVector::ZeroVector;
+	FVector DesiredVelocity = FVector::ZeroVector;
+	float Yaw = 0.0f;
+	float YawVelocity = 0.0f;
+	float DesiredYaw = 0.0f;
+
+};